@@ -0,0 +1,178 @@
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "ft_pathcache.h"
+
+// glibc's execvp default when PATH is unset
+#define FT_DEFAULT_PATH "/bin:/usr/bin"
+
+typedef struct s_path_entry
+{
+    char            *name;
+    char            *path;
+    dev_t           dev;
+    ino_t           ino;
+    struct timespec mtime;
+}   t_path_entry;
+
+// direct-mapped: a collision just replaces the older entry
+static t_path_entry g_cache[FT_PATHCACHE_SLOTS];
+static char *g_path_env = NULL;
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static const char *path_env(void)
+{
+    const char *env;
+
+    env = getenv("PATH");
+    if(!env)
+        return(FT_DEFAULT_PATH);
+    return(env);
+}
+
+static unsigned int path_hash(const char *name)
+{
+    unsigned int h;
+
+    h = 5381;
+    while(*name)
+        h = h * 33 + (unsigned char)*name++;
+    return(h % FT_PATHCACHE_SLOTS);
+}
+
+static void entry_clear(t_path_entry *e)
+{
+    free(e->name);
+    free(e->path);
+    memset(e, 0, sizeof(*e));
+}
+
+static int same_binary(const t_path_entry *e, const struct stat *st)
+{
+    return(e->dev == st->st_dev && e->ino == st->st_ino
+        && e->mtime.tv_sec == st->st_mtim.tv_sec
+        && e->mtime.tv_nsec == st->st_mtim.tv_nsec);
+}
+
+void ft_path_flush(void)
+{
+    int i;
+
+    pthread_mutex_lock(&g_lock);
+    i = -1;
+    while(++i < FT_PATHCACHE_SLOTS)
+        entry_clear(&g_cache[i]);
+    free(g_path_env);
+    g_path_env = NULL;
+    pthread_mutex_unlock(&g_lock);
+}
+
+// under g_lock: the whole cache belongs to one value of PATH
+static int cache_sync_env(const char *env)
+{
+    int i;
+
+    if(g_path_env && strcmp(g_path_env, env) == 0)
+        return(0);
+    i = -1;
+    while(++i < FT_PATHCACHE_SLOTS)
+        entry_clear(&g_cache[i]);
+    free(g_path_env);
+    g_path_env = strdup(env);
+    return(g_path_env ? 0 : -1);
+}
+
+// the same walk execvp does, an empty PATH entry meaning "."
+static int path_search(const char *env, const char *name, char *out,
+    size_t size, struct stat *st)
+{
+    const char *dir;
+    const char *end;
+    size_t dlen;
+    size_t nlen;
+
+    nlen = strlen(name);
+    dir = env;
+    while(1)
+    {
+        end = strchr(dir, ':');
+        dlen = end ? (size_t)(end - dir) : strlen(dir);
+        if(dlen == 0)
+        {
+            dir = ".";
+            dlen = 1;
+        }
+        if(dlen + nlen + 2 <= size)
+        {
+            memcpy(out, dir, dlen);
+            out[dlen] = '/';
+            memcpy(out + dlen + 1, name, nlen + 1);
+            if(stat(out, st) == 0 && S_ISREG(st->st_mode)
+                && access(out, X_OK) == 0)
+                return(0);
+        }
+        if(!end)
+            return(-1);
+        dir = end + 1;
+    }
+}
+
+static void cache_store(const char *env, const char *name, const char *path,
+    const struct stat *st)
+{
+    t_path_entry *e;
+
+    pthread_mutex_lock(&g_lock);
+    if(cache_sync_env(env) == 0)
+    {
+        e = &g_cache[path_hash(name)];
+        entry_clear(e);
+        e->name = strdup(name);
+        e->path = strdup(path);
+        if(!e->name || !e->path)
+            entry_clear(e);
+        else
+        {
+            e->dev = st->st_dev;
+            e->ino = st->st_ino;
+            e->mtime = st->st_mtim;
+        }
+    }
+    pthread_mutex_unlock(&g_lock);
+}
+
+int ft_path_resolve(const char *name, char *out, size_t size)
+{
+    t_path_entry *e;
+    struct stat st;
+    const char *env;
+    int hit;
+
+    if(!name || !*name || strchr(name, '/') || size == 0)
+        return(-1);
+    env = path_env();
+    hit = 0;
+    pthread_mutex_lock(&g_lock);
+    e = &g_cache[path_hash(name)];
+    if(cache_sync_env(env) == 0 && e->name && strcmp(e->name, name) == 0)
+    {
+        if(stat(e->path, &st) == 0 && same_binary(e, &st)
+            && strlen(e->path) < size)
+        {
+            strcpy(out, e->path);
+            hit = 1;
+        }
+        else
+            entry_clear(e);
+    }
+    pthread_mutex_unlock(&g_lock);
+    if(hit)
+        return(0);
+    if(path_search(env, name, out, size, &st) == -1)
+        return(-1);
+    cache_store(env, name, out, &st);
+    return(0);
+}
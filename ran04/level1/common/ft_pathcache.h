@@ -0,0 +1,20 @@
+#ifndef FT_PATHCACHE_H
+# define FT_PATHCACHE_H
+
+# include <stddef.h>
+
+// Resolved-path cache for execvp-style lookups, shared by ft_popen and
+// picoshell. Resolve in the parent before forking, then execv() the
+// absolute path in the child; if that fails, execvp() still runs as the
+// fallback (scripts without #!, binaries that moved since the lookup).
+# ifndef FT_PATHCACHE_SLOTS
+#  define FT_PATHCACHE_SLOTS 128
+# endif
+
+// 0 and the absolute path in out, or -1 when name holds a '/', is not
+// found on PATH or does not fit: the caller then uses execvp(name).
+// An entry is dropped when PATH changes or the binary's mtime/inode does.
+int     ft_path_resolve(const char *name, char *out, size_t size);
+void    ft_path_flush(void);
+
+#endif
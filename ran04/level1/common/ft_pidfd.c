@@ -0,0 +1,90 @@
+#define _GNU_SOURCE
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/wait.h>
+#include <sys/pidfd.h>
+#include "ft_pidfd.h"
+
+// from <linux/wait.h>, which clashes with <sys/wait.h>
+#ifndef P_PIDFD
+# define P_PIDFD 3
+#endif
+
+int ft_pidfd_open(pid_t pid)
+{
+    return(pidfd_open(pid, 0));
+}
+
+// FT_PIDFD_EXITED once the child is gone (not reaped yet),
+// FT_PIDFD_TIMEOUT after timeout_ms (-1 waits forever), -1 on error
+int ft_pidfd_wait(int pidfd, int timeout_ms)
+{
+    struct pollfd pfd;
+    int n;
+
+    pfd.fd = pidfd;
+    pfd.events = POLLIN;
+    while((n = poll(&pfd, 1, timeout_ms)) == -1 && errno == EINTR)
+        ;
+    if(n == -1)
+        return(-1);
+    return(n ? FT_PIDFD_EXITED : FT_PIDFD_TIMEOUT);
+}
+
+int ft_pidfd_kill(int pidfd, int sig)
+{
+    return(pidfd_send_signal(pidfd, sig, NULL, 0));
+}
+
+// Blocks until the child exits, reaps it and closes pidfd. status (may
+// be NULL) gets a waitpid-style status so WIFEXITED() and friends work.
+int ft_pidfd_reap(int pidfd, int *status)
+{
+    siginfo_t info;
+    int ret;
+
+    memset(&info, 0, sizeof(info));
+    while((ret = waitid(P_PIDFD, pidfd, &info, WEXITED)) == -1 && errno == EINTR)
+        ;
+    close(pidfd);
+    if(ret == -1)
+        return(-1);
+    if(!status)
+        return(0);
+    if(info.si_code == CLD_EXITED)
+        *status = (info.si_status & 0xff) << 8;
+    else if(info.si_code == CLD_DUMPED)
+        *status = info.si_status | 0x80;
+    else
+        *status = info.si_status;
+    return(0);
+}
+
+// The timeout logic shared by sandbox and deadline streams: wait up to
+// timeout_ms (-1 forever), SIGKILL the child if it is still running,
+// then reap it and close pidfd either way. Returns FT_PIDFD_EXITED,
+// FT_PIDFD_TIMEOUT, or -1 (the child is still killed and reaped).
+int ft_pidfd_wait_kill(int pidfd, int timeout_ms, int *status)
+{
+    int ret;
+
+    ret = ft_pidfd_wait(pidfd, timeout_ms);
+    if(ret != FT_PIDFD_EXITED)
+        ft_pidfd_kill(pidfd, SIGKILL);
+    if(ft_pidfd_reap(pidfd, status) == -1)
+        return(-1);
+    return(ret);
+}
+
+// CLOCK_MONOTONIC in milliseconds, for deadlines
+long ft_now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return(ts.tv_sec * 1000L + ts.tv_nsec / 1000000L);
+}
@@ -0,0 +1,20 @@
+#ifndef FT_PIDFD_H
+# define FT_PIDFD_H
+
+# include <sys/types.h>
+
+// Child tracking through pidfds, shared by ft_popen and sandbox. A pidfd
+// turns readable when the child exits, so exits can be poll()ed next to
+// any other fd, timeouts need no SIGALRM, and a kill can never hit a
+// recycled pid. All of them are O_CLOEXEC.
+# define FT_PIDFD_EXITED  1
+# define FT_PIDFD_TIMEOUT 0
+
+int     ft_pidfd_open(pid_t pid);
+int     ft_pidfd_wait(int pidfd, int timeout_ms);
+int     ft_pidfd_kill(int pidfd, int sig);
+int     ft_pidfd_reap(int pidfd, int *status);
+int     ft_pidfd_wait_kill(int pidfd, int timeout_ms, int *status);
+long    ft_now_ms(void);
+
+#endif
@@ -0,0 +1,64 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include "../ft_popen.h"
+
+// ft_popen_many against the naive ft_popen / read / ft_pclose loop.
+// Build: gcc -O2 -o bench_many bench/bench_many.c ft_popen.c ft_popen_many.c ft_spawn.c ft_pipe_size.c ../common/ft_pathcache.c ../common/ft_pidfd.c
+// Usage: ./bench_many [commands] [max_parallel]   (default: 200 32)
+
+static double now_s(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec + ts.tv_nsec / 1e9);
+}
+
+static size_t naive(char **const cmds[], size_t n)
+{
+    char buf[4096];
+    size_t total = 0;
+    ssize_t r;
+
+    for (size_t i = 0; i < n; i++) {
+        int fd = ft_popen(cmds[i][0], cmds[i], 'r');
+        if (fd == -1)
+            continue;
+        while ((r = read(fd, buf, sizeof(buf))) > 0)
+            total += r;
+        ft_pclose(fd);
+    }
+    return (total);
+}
+
+int main(int argc, char **argv)
+{
+    size_t n = argc > 1 ? (size_t)atol(argv[1]) : 200;
+    size_t par = argc > 2 ? (size_t)atol(argv[2]) : 32;
+    char *cmd[] = {"sh", "-c", "echo start; sleep 0.01; echo done", NULL};
+    char ***cmds = malloc(n * sizeof(*cmds));
+    t_popen_result *res = malloc(n * sizeof(*res));
+    size_t total = 0;
+    double t0;
+
+    if (!cmds || !res)
+        return (1);
+    for (size_t i = 0; i < n; i++)
+        cmds[i] = cmd;
+    t0 = now_s();
+    total = naive(cmds, n);
+    printf("%-14s %8.3f s  %zu bytes\n", "naive loop", now_s() - t0, total);
+    t0 = now_s();
+    ft_popen_many(cmds, n, par, res);
+    total = 0;
+    for (size_t i = 0; i < n; i++) {
+        total += res[i].len;
+        free(res[i].out);
+    }
+    printf("%-14s %8.3f s  %zu bytes  (max_parallel %zu)\n", "ft_popen_many", now_s() - t0, total, par);
+    free(res);
+    free(cmds);
+    return (0);
+}
@@ -0,0 +1,62 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <fcntl.h>
+#include "../ft_popen.h"
+
+// Read throughput of an ft_popen 'r' stream for several pipe capacities.
+// Build: gcc -O2 -o bench_pipe bench/bench_pipe.c ft_popen.c ft_spawn.c ft_pipe_size.c ../common/ft_pathcache.c ../common/ft_pidfd.c
+// Usage: ./bench_pipe [MiB to transfer]   (default: 1024)
+
+static double now_s(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec + ts.tv_nsec / 1e9);
+}
+
+static double throughput_mbs(size_t pipe_size, size_t mib, long *actual)
+{
+    char count[32];
+    char *args[] = {"head", "-c", count, "/dev/zero", NULL};
+    t_popen_opts opts = {.pipe_size = pipe_size};
+    size_t bufsize = 1 << 20;
+    char *buf = malloc(bufsize);
+    size_t total = 0;
+    ssize_t n;
+    double t0;
+    int fd;
+
+    snprintf(count, sizeof(count), "%zu", mib << 20);
+    t0 = now_s();
+    fd = ft_popen_ex("head", args, 'r', &opts);
+    if (fd == -1 || !buf) {
+        free(buf);
+        return (-1);
+    }
+    *actual = fcntl(fd, F_GETPIPE_SZ);
+    while ((n = read(fd, buf, bufsize)) > 0)
+        total += n;
+    ft_pclose(fd);
+    free(buf);
+    return (total / (1024.0 * 1024.0) / (now_s() - t0));
+}
+
+int main(int argc, char **argv)
+{
+    size_t mib = argc > 1 ? (size_t)atol(argv[1]) : 1024;
+    size_t sizes[] = {64 * 1024, 1024 * 1024, (size_t)ft_pipe_max_size()};
+    const char *names[] = {"64 KiB", "1 MiB", "max"};
+    long actual = 0;
+
+    printf("%-8s %12s %12s   (%zu MiB through head -c)\n", "size", "capacity", "MB/s", mib);
+    for (int i = 0; i < 3; i++) {
+        double mbs = throughput_mbs(sizes[i], mib, &actual);
+        printf("%-8s %12ld %12.1f\n", names[i], actual, mbs);
+    }
+    return (0);
+}
@@ -0,0 +1,74 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/wait.h>
+#include "../ft_popen.h"
+
+// Spawn latency per backend while the parent holds a growing, touched heap.
+// Build: gcc -O2 -o bench_spawn bench/bench_spawn.c ft_popen.c ft_spawn.c ft_pipe_size.c ../common/ft_pathcache.c ../common/ft_pidfd.c
+// Usage: ./bench_spawn [iterations] [heap MiB ...]   (default: 200 0 256 1024)
+
+static const char *g_names[] = {"fork", "vfork", "posix", "clone"};
+
+static double now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec * 1e6 + ts.tv_nsec / 1e3);
+}
+
+static double spawn_latency_us(int backend, int iterations)
+{
+    char *args[] = {"true", NULL};
+    char buf[64];
+    double total = 0;
+    double t0;
+    int fd;
+
+    ft_popen_set_spawn(backend);
+    for (int i = 0; i < iterations; i++) {
+        t0 = now_us();
+        fd = ft_popen("true", args, 'r');
+        total += now_us() - t0;
+        if (fd == -1)
+            return (-1);
+        while (read(fd, buf, sizeof(buf)) > 0)
+            ;
+        close(fd);
+        wait(NULL);
+    }
+    return (total / iterations);
+}
+
+int main(int argc, char **argv)
+{
+    static const int default_heaps[] = {0, 256, 1024};
+    int iterations = argc > 1 ? atoi(argv[1]) : 200;
+    int nheaps = argc > 2 ? argc - 2 : 3;
+    char *heap = NULL;
+
+    printf("%-10s", "heap MiB");
+    for (int b = FT_SPAWN_FORK; b <= FT_SPAWN_CLONE; b++)
+        printf("%12s", g_names[b]);
+    printf("   (us per ft_popen call, %d iterations)\n", iterations);
+    for (int h = 0; h < nheaps; h++) {
+        size_t mib = argc > 2 ? (size_t)atoi(argv[h + 2]) : (size_t)default_heaps[h];
+
+        free(heap);
+        heap = mib ? malloc(mib << 20) : NULL;
+        if (mib && !heap) {
+            printf("%-10zu  allocation failed\n", mib);
+            continue;
+        }
+        for (size_t off = 0; heap && off < (mib << 20); off += 4096)
+            ((volatile char *)heap)[off] = 1;
+        printf("%-10zu", mib);
+        for (int b = FT_SPAWN_FORK; b <= FT_SPAWN_CLONE; b++)
+            printf("%12.1f", spawn_latency_us(b, iterations));
+        printf("\n");
+    }
+    free(heap);
+    return (0);
+}
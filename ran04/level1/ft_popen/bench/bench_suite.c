@@ -0,0 +1,285 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/utsname.h>
+#include "../ft_popen.h"
+
+// Regression suite: every backend x mode x parent heap x open fd count,
+// one record per combination, meant to be diffed across releases.
+//  spawns_per_s        ft_popen + drain + ft_pclose round trips per second
+//  p50_us / p99_us     latency of the ft_popen call alone
+//  ttfb_p50_us / p99   ft_popen until the first byte of `echo x` ('r' only),
+//                      over the runs that got a byte
+//  ttfb_fail           runs where the first read got nothing ('r' only)
+//  mb_s                pipe throughput, head -c from /dev/zero ('r') or
+//                      into dd of=/dev/null ('w')
+// Output is one JSON object per line (-c for CSV), the first one
+// describes the machine so runs from different hosts are not mixed up.
+// Build: gcc -O2 -o bench_suite bench/bench_suite.c ft_popen.c ft_spawn.c ft_pipe_size.c ../common/ft_pathcache.c ../common/ft_pidfd.c
+// Usage: ./bench_suite [-c] [-n iterations] [-m MiB] [-H heaps] [-F fds] [-b backends]
+//        lists are comma separated, e.g. -H 0,256,1024 -F 0,1000,10000 -b fork,posix
+//        (default: -n 200 -m 256 -H 0,256,1024 -F 0,1000,10000 -b fork,vfork,posix,clone)
+
+#define MAX_LIST 16
+
+static const char *g_names[] = {"fork", "vfork", "posix", "clone"};
+
+typedef struct s_result
+{
+    double  spawns_per_s;
+    double  p50_us;
+    double  p99_us;
+    double  ttfb_p50_us;
+    double  ttfb_p99_us;
+    long    ttfb_fail;
+    double  mb_s;
+}   t_result;
+
+static double now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec * 1e6 + ts.tv_nsec / 1e3);
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return ((x > y) - (x < y));
+}
+
+// nearest-rank percentile of an already sorted sample
+static double percentile(const double *v, int n, double p)
+{
+    int rank = (int)(p / 100.0 * n + 0.999999);
+
+    if (n == 0)
+        return (-1);
+    if (rank < 1)
+        rank = 1;
+    return (v[rank > n ? n - 1 : rank - 1]);
+}
+
+static int parse_list(char *s, long *out, int numeric)
+{
+    int n = 0;
+
+    for (char *tok = strtok(s, ","); tok && n < MAX_LIST; tok = strtok(NULL, ",")) {
+        if (numeric)
+            out[n++] = atol(tok);
+        else {
+            for (int b = FT_SPAWN_FORK; b <= FT_SPAWN_CLONE; b++)
+                if (strcmp(tok, g_names[b]) == 0)
+                    out[n++] = b;
+        }
+    }
+    return (n);
+}
+
+// the heap the child's page tables are copied from, touched page by page
+static char *grow_heap(char *heap, size_t mib)
+{
+    free(heap);
+    heap = mib ? malloc(mib << 20) : NULL;
+    for (size_t off = 0; heap && off < (mib << 20); off += 4096)
+        ((volatile char *)heap)[off] = 1;
+    return (heap);
+}
+
+// keeps nfds extra descriptors open (plain dups, not O_CLOEXEC), returns
+// how many it managed to open; closes the previous set first
+static long hold_fds(int *held, long nheld, long nfds)
+{
+    long i;
+
+    while (nheld > 0)
+        close(held[--nheld]);
+    for (i = 0; i < nfds; i++) {
+        held[i] = dup(STDERR_FILENO);
+        if (held[i] == -1)
+            break;
+    }
+    return (i);
+}
+
+static double throughput_mbs(char mode, size_t mib)
+{
+    char count[32];
+    char *rargs[] = {"head", "-c", count, "/dev/zero", NULL};
+    char *wargs[] = {"dd", "of=/dev/null", "bs=1M", "status=none", NULL};
+    size_t bufsize = 1 << 20;
+    char *buf = calloc(1, bufsize);
+    size_t total = 0;
+    ssize_t n = 1;
+    double t0;
+    int fd;
+
+    snprintf(count, sizeof(count), "%zu", mib << 20);
+    t0 = now_us();
+    fd = mode == 'r' ? ft_popen("head", rargs, 'r') : ft_popen("dd", wargs, 'w');
+    if (fd == -1 || !buf) {
+        free(buf);
+        return (-1);
+    }
+    while (mode == 'r' && (n = read(fd, buf, bufsize)) > 0)
+        total += n;
+    while (mode == 'w' && total < (mib << 20) && (n = write(fd, buf, bufsize)) > 0)
+        total += n;
+    ft_pclose(fd);
+    free(buf);
+    return (total / (1024.0 * 1024.0) / ((now_us() - t0) / 1e6));
+}
+
+static int run_case(char mode, int iterations, size_t mib, t_result *res)
+{
+    char *rargs[] = {"echo", "x", NULL};
+    char *wargs[] = {"true", NULL};
+    double *lat = malloc(iterations * sizeof(double));
+    double *ttfb = malloc(iterations * sizeof(double));
+    double t0, start;
+    char buf[64];
+    int i, fd, nttfb = 0;
+
+    if (!lat || !ttfb) {
+        free(lat);
+        free(ttfb);
+        return (-1);
+    }
+    start = now_us();
+    for (i = 0; i < iterations; i++) {
+        t0 = now_us();
+        fd = mode == 'r' ? ft_popen("echo", rargs, 'r') : ft_popen("true", wargs, 'w');
+        lat[i] = now_us() - t0;
+        if (fd == -1)
+            break;
+        if (mode == 'r' && read(fd, buf, sizeof(buf)) > 0)
+            ttfb[nttfb++] = now_us() - t0;
+        while (mode == 'r' && read(fd, buf, sizeof(buf)) > 0)
+            ;
+        ft_pclose(fd);
+    }
+    res->spawns_per_s = i / ((now_us() - start) / 1e6);
+    qsort(lat, i, sizeof(double), cmp_double);
+    qsort(ttfb, nttfb, sizeof(double), cmp_double);
+    res->p50_us = percentile(lat, i, 50);
+    res->p99_us = percentile(lat, i, 99);
+    res->ttfb_p50_us = mode == 'r' ? percentile(ttfb, nttfb, 50) : -1;
+    res->ttfb_p99_us = mode == 'r' ? percentile(ttfb, nttfb, 99) : -1;
+    res->ttfb_fail = mode == 'r' ? i - nttfb : -1;
+    res->mb_s = throughput_mbs(mode, mib);
+    free(lat);
+    free(ttfb);
+    return (i == iterations ? 0 : -1);
+}
+
+static void print_meta(int csv, int iterations, size_t mib)
+{
+    struct utsname u;
+
+    uname(&u);
+    if (csv) {
+        printf("# kernel=%s machine=%s cpus=%ld iterations=%d mib=%zu pipe_max=%ld\n",
+            u.release, u.machine, sysconf(_SC_NPROCESSORS_ONLN), iterations, mib,
+            ft_pipe_max_size());
+        printf("backend,mode,heap_mib,open_fds,spawns_per_s,p50_us,p99_us,"
+            "ttfb_p50_us,ttfb_p99_us,ttfb_fail,mb_s,ok\n");
+        return;
+    }
+    printf("{\"type\":\"meta\",\"kernel\":\"%s\",\"machine\":\"%s\",\"cpus\":%ld,"
+        "\"iterations\":%d,\"mib\":%zu,\"pipe_max\":%ld}\n",
+        u.release, u.machine, sysconf(_SC_NPROCESSORS_ONLN), iterations, mib,
+        ft_pipe_max_size());
+}
+
+static void print_result(int csv, int backend, char mode, long heap, long fds,
+    const t_result *r, int ok)
+{
+    if (csv) {
+        printf("%s,%c,%ld,%ld,%.1f,%.1f,%.1f,%.1f,%.1f,%ld,%.1f,%d\n", g_names[backend],
+            mode, heap, fds, r->spawns_per_s, r->p50_us, r->p99_us, r->ttfb_p50_us,
+            r->ttfb_p99_us, r->ttfb_fail, r->mb_s, ok);
+        return;
+    }
+    printf("{\"type\":\"result\",\"backend\":\"%s\",\"mode\":\"%c\",\"heap_mib\":%ld,"
+        "\"open_fds\":%ld,\"spawns_per_s\":%.1f,\"p50_us\":%.1f,\"p99_us\":%.1f,"
+        "\"ttfb_p50_us\":%.1f,\"ttfb_p99_us\":%.1f,\"ttfb_fail\":%ld,\"mb_s\":%.1f,"
+        "\"ok\":%s}\n",
+        g_names[backend], mode, heap, fds, r->spawns_per_s, r->p50_us, r->p99_us,
+        r->ttfb_p50_us, r->ttfb_p99_us, r->ttfb_fail, r->mb_s, ok ? "true" : "false");
+}
+
+int main(int argc, char **argv)
+{
+    long heaps[MAX_LIST] = {0, 256, 1024}, fds[MAX_LIST] = {0, 1000, 10000};
+    long backends[MAX_LIST] = {FT_SPAWN_FORK, FT_SPAWN_VFORK, FT_SPAWN_POSIX, FT_SPAWN_CLONE};
+    int nheaps = 3, nfds = 3, nbackends = 4;
+    int iterations = 200, csv = 0, opt;
+    size_t mib = 256;
+    struct rlimit rl;
+    char *heap = NULL;
+    int *held;
+    long nheld = 0, maxfd = 0;
+
+    while ((opt = getopt(argc, argv, "cn:m:H:F:b:")) != -1) {
+        if (opt == 'c')
+            csv = 1;
+        else if (opt == 'n')
+            iterations = atoi(optarg);
+        else if (opt == 'm')
+            mib = (size_t)atol(optarg);
+        else if (opt == 'H')
+            nheaps = parse_list(optarg, heaps, 1);
+        else if (opt == 'F')
+            nfds = parse_list(optarg, fds, 1);
+        else if (opt == 'b')
+            nbackends = parse_list(optarg, backends, 0);
+        else {
+            fprintf(stderr, "usage: %s [-c] [-n iterations] [-m MiB] [-H heaps] "
+                "[-F fds] [-b backends]\n", argv[0]);
+            return (2);
+        }
+    }
+    if (iterations <= 0)
+        iterations = 1;
+    for (int f = 0; f < nfds; f++)
+        maxfd = fds[f] > maxfd ? fds[f] : maxfd;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < (rlim_t)maxfd + 64) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+    held = malloc((maxfd + 1) * sizeof(int));
+    if (!held)
+        return (1);
+    print_meta(csv, iterations, mib);
+    for (int h = 0; h < nheaps; h++) {
+        heap = grow_heap(heap, heaps[h]);
+        if (heaps[h] && !heap) {
+            fprintf(stderr, "bench_suite: could not allocate %ld MiB\n", heaps[h]);
+            continue;
+        }
+        for (int f = 0; f < nfds; f++) {
+            nheld = hold_fds(held, nheld, fds[f]);
+            for (int b = 0; b < nbackends; b++) {
+                ft_popen_set_spawn(backends[b]);
+                for (int m = 0; m < 2; m++) {
+                    t_result r = {-1, -1, -1, -1, -1, -1, -1};
+                    int ok = run_case("rw"[m], iterations, mib, &r) == 0;
+
+                    print_result(csv, backends[b], "rw"[m], heaps[h], nheld, &r, ok);
+                    fflush(stdout);
+                }
+            }
+        }
+    }
+    hold_fds(held, nheld, 0);
+    free(held);
+    free(heap);
+    return (0);
+}
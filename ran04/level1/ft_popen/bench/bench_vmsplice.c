@@ -0,0 +1,72 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include "../ft_popen.h"
+
+// Feeding a 'w' stream: write() copies against ft_popen_vmsplice() gifts.
+// Two pipe-capacity buffers are fed alternately, the reuse rule from
+// ft_popen_vmsplice.c, and refilled before each round like a producer.
+// Build: gcc -O2 -o bench_vmsplice bench/bench_vmsplice.c ft_popen.c ft_popen_vmsplice.c ft_spawn.c ft_pipe_size.c ../common/ft_pathcache.c ../common/ft_pidfd.c
+// Usage: ./bench_vmsplice [MiB to transfer] [command]   (default: 1024 wc -c)
+
+static double now_s(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec + ts.tv_nsec / 1e9);
+}
+
+static double feed_mbs(char **cmd, size_t mib, int use_vmsplice)
+{
+    t_popen_opts opts = {0, (size_t)ft_pipe_max_size(), 0};
+    size_t total = mib << 20;
+    size_t cap, sent = 0;
+    char *bufs[2];
+    double t0;
+    int fd, round = 0;
+
+    fd = ft_popen_ex(cmd[0], cmd, 'w', &opts);
+    if (fd == -1)
+        return (-1);
+    cap = fcntl(fd, F_GETPIPE_SZ);
+    bufs[0] = mmap(NULL, 2 * cap, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (bufs[0] == MAP_FAILED) {
+        ft_pclose(fd);
+        return (-1);
+    }
+    bufs[1] = bufs[0] + cap;
+    t0 = now_s();
+    while (sent < total) {
+        char *b = bufs[round++ & 1];
+        size_t len = total - sent < cap ? total - sent : cap;
+        ssize_t n;
+
+        memset(b, 'a' + (round % 26), len);
+        n = use_vmsplice ? ft_popen_vmsplice(fd, b, len) : write(fd, b, len);
+        if (n <= 0)
+            break;
+        sent += n;
+    }
+    ft_pclose(fd);
+    munmap(bufs[0], 2 * cap);
+    return (sent / (1024.0 * 1024.0) / (now_s() - t0));
+}
+
+int main(int argc, char **argv)
+{
+    size_t mib = argc > 1 ? (size_t)atol(argv[1]) : 1024;
+    char *def[] = {"wc", "-c", NULL};
+    char **cmd = argc > 2 ? argv + 2 : def;
+
+    printf("%-10s %12s   (%zu MiB into %s)\n", "mode", "MB/s", mib, cmd[0]);
+    printf("%-10s %12.1f\n", "write", feed_mbs(cmd, mib, 0));
+    printf("%-10s %12.1f\n", "vmsplice", feed_mbs(cmd, mib, 1));
+    return (0);
+}
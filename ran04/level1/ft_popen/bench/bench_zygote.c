@@ -0,0 +1,62 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include "../ft_popen.h"
+
+// Spawns per second through the zygote helper vs. direct ft_popen, with
+// the helper started before the parent grows a large touched heap.
+// Build: gcc -O2 -o bench_zygote bench/bench_zygote.c ft_popen.c ft_spawn.c ft_pipe_size.c ft_zygote.c ../common/ft_pathcache.c ../common/ft_pidfd.c -lpthread
+// Usage: ./bench_zygote [spawns] [heap MiB]   (default: 500 1024)
+
+static double now_s(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec + ts.tv_nsec / 1e9);
+}
+
+static double spawns_per_sec(int (*spawn)(const char *, char *const [], char), int n)
+{
+    char *args[] = {"true", NULL};
+    char buf[64];
+    double t0 = now_s();
+
+    for (int i = 0; i < n; i++) {
+        int fd = spawn("true", args, 'r');
+        if (fd == -1)
+            return (-1);
+        while (read(fd, buf, sizeof(buf)) > 0)
+            ;
+        ft_pclose(fd);
+    }
+    return (n / (now_s() - t0));
+}
+
+int main(int argc, char **argv)
+{
+    int n = argc > 1 ? atoi(argv[1]) : 500;
+    size_t mib = argc > 2 ? (size_t)atol(argv[2]) : 1024;
+    char *heap;
+
+    if (ft_zygote_start() == -1) {
+        perror("ft_zygote_start");
+        return (1);
+    }
+    heap = malloc(mib << 20);
+    if (mib && !heap)
+        return (1);
+    for (size_t off = 0; off < (mib << 20); off += 4096)
+        ((volatile char *)heap)[off] = 1;
+    printf("%-8s %14s   (%d spawns of true, %zu MiB parent heap)\n", "path", "spawns/s", n, mib);
+    for (int b = FT_SPAWN_FORK; b <= FT_SPAWN_CLONE; b++) {
+        static const char *names[] = {"fork", "vfork", "posix", "clone"};
+        ft_popen_set_spawn(b);
+        printf("%-8s %14.0f\n", names[b], spawns_per_sec(ft_popen, n));
+    }
+    printf("%-8s %14.0f\n", "zygote", spawns_per_sec(ft_zygote_popen, n));
+    ft_zygote_stop();
+    free(heap);
+    return (0);
+}
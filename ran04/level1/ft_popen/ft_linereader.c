@@ -0,0 +1,165 @@
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "ft_popen.h"
+#if defined(__x86_64__) || defined(__i386__)
+# include <immintrin.h>
+#endif
+
+#define FT_LR_DEFAULT (256 * 1024)
+
+typedef const char *(*t_nl_scan)(const char *p, const char *end);
+
+static const char *nl_scalar(const char *p, const char *end)
+{
+    while(p < end)
+    {
+        if(*p == '\n')
+            return(p);
+        p++;
+    }
+    return(NULL);
+}
+
+#ifdef __SSE2__
+
+static const char *nl_sse2(const char *p, const char *end)
+{
+    const __m128i nl = _mm_set1_epi8('\n');
+    unsigned int mask;
+
+    while(end - p >= 16)
+    {
+        mask = _mm_movemask_epi8(_mm_cmpeq_epi8(
+            _mm_loadu_si128((const __m128i *)p), nl));
+        if(mask)
+            return(p + __builtin_ctz(mask));
+        p += 16;
+    }
+    return(nl_scalar(p, end));
+}
+
+__attribute__((target("avx2")))
+static const char *nl_avx2(const char *p, const char *end)
+{
+    const __m256i nl = _mm256_set1_epi8('\n');
+    unsigned int mask;
+
+    while(end - p >= 32)
+    {
+        mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(
+            _mm256_loadu_si256((const __m256i *)p), nl));
+        if(mask)
+            return(p + __builtin_ctz(mask));
+        p += 32;
+    }
+    return(nl_sse2(p, end));
+}
+
+#endif
+
+// picked once from what the CPU supports
+static t_nl_scan nl_scanner(void)
+{
+    static t_nl_scan scan = NULL;
+
+    if(scan)
+        return(scan);
+#ifdef __SSE2__
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2"))
+        scan = nl_avx2;
+    else
+        scan = nl_sse2;
+#else
+    scan = nl_scalar;
+#endif
+    return(scan);
+}
+
+int ft_lr_init(t_linereader *lr, int fd, size_t cap)
+{
+    if(cap == 0)
+        cap = FT_LR_DEFAULT;
+    lr->buf = malloc(cap);
+    if(!lr->buf)
+        return(-1);
+    lr->fd = fd;
+    lr->cap = cap;
+    lr->start = 0;
+    lr->scan = 0;
+    lr->end = 0;
+    lr->eof = 0;
+    return(0);
+}
+
+// makes room after end: slide the pending bytes down, grow only when a
+// single line fills the whole buffer
+static int lr_fill(t_linereader *lr)
+{
+    char *tmp;
+    ssize_t n;
+
+    if(lr->start > 0)
+    {
+        memmove(lr->buf, lr->buf + lr->start, lr->end - lr->start);
+        lr->end -= lr->start;
+        lr->scan -= lr->start;
+        lr->start = 0;
+    }
+    if(lr->end == lr->cap)
+    {
+        tmp = realloc(lr->buf, lr->cap * 2);
+        if(!tmp)
+            return(-1);
+        lr->buf = tmp;
+        lr->cap *= 2;
+    }
+    while((n = read(lr->fd, lr->buf + lr->end, lr->cap - lr->end)) == -1
+        && errno == EINTR)
+        ;
+    if(n == -1)
+        return(-1);
+    if(n == 0)
+        lr->eof = 1;
+    lr->end += n;
+    return(0);
+}
+
+// 1 and the next line, 0 at end of stream, -1 on error. A last line
+// without '\n' is still returned.
+int ft_lr_next(t_linereader *lr, t_line *line)
+{
+    const char *nl;
+
+    while(1)
+    {
+        nl = nl_scanner()(lr->buf + lr->scan, lr->buf + lr->end);
+        if(nl)
+        {
+            line->ptr = lr->buf + lr->start;
+            line->len = nl - line->ptr;
+            lr->start = nl - lr->buf + 1;
+            lr->scan = lr->start;
+            return(1);
+        }
+        lr->scan = lr->end;
+        if(lr->eof)
+            break;
+        if(lr_fill(lr) == -1)
+            return(-1);
+    }
+    if(lr->start == lr->end)
+        return(0);
+    line->ptr = lr->buf + lr->start;
+    line->len = lr->end - lr->start;
+    lr->start = lr->end;
+    return(1);
+}
+
+void ft_lr_free(t_linereader *lr)
+{
+    free(lr->buf);
+    lr->buf = NULL;
+}
@@ -0,0 +1,48 @@
+#define _GNU_SOURCE
+#include <unistd.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include "ft_popen.h"
+
+// kernel default when /proc is not readable
+#define FT_PIPE_DEFAULT_MAX (1024 * 1024)
+
+static long g_pipe_max = 0;
+
+// /proc/sys/fs/pipe-max-size, read once
+long ft_pipe_max_size(void)
+{
+    char buf[32];
+    ssize_t n;
+    int fd;
+
+    if(g_pipe_max > 0)
+        return(g_pipe_max);
+    g_pipe_max = FT_PIPE_DEFAULT_MAX;
+    fd = open("/proc/sys/fs/pipe-max-size", O_RDONLY | O_CLOEXEC);
+    if(fd == -1)
+        return(g_pipe_max);
+    n = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if(n > 0)
+    {
+        buf[n] = '\0';
+        if(atol(buf) > 0)
+            g_pipe_max = atol(buf);
+    }
+    return(g_pipe_max);
+}
+
+// Best effort: an unprivileged process past pipe-user-pages-soft gets
+// EPERM and simply keeps the default capacity. Returns the capacity the
+// pipe ends up with, or -1 if fd is not a pipe.
+long ft_pipe_set_size(int fd, size_t size)
+{
+    long max;
+
+    max = ft_pipe_max_size();
+    if(size > (size_t)max)
+        size = max;
+    fcntl(fd, F_SETPIPE_SZ, (int)size);
+    return(fcntl(fd, F_GETPIPE_SZ));
+}
@@ -1,57 +1,248 @@
-
+#define _GNU_SOURCE
 #include <unistd.h>
 #include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <poll.h>
 #include <sys/types.h>
+#include <sys/wait.h>
+#include "ft_popen.h"
+#include "../common/ft_pidfd.h"
 
 
 //pipe give fd[0](read), fd[1](write)
-// if pid == 0 then child process otherwise parent
+// the child is created by ft_spawn() with the backend picked at build or
+// run time (see ft_popen.h), the pipe wiring is the same for all of them
+
+// one slot per fd number: an fd is only ever owned by one stream at a
+// time, so lookup, insert and reap are O(1) and need no lock. That holds
+// only while the fd is open: ft_pclose copies the slot out before
+// close(), since another thread's ft_popen may get the same number (and
+// slot) right after it.
+// deadline is in ft_now_ms() time, 0 when the stream has none
+typedef struct s_popen_slot
+{
+    pid_t       pid;
+    int         pidfd;
+    int         timedout;
+    long        deadline;
+    t_reaper    reap;
+}   t_popen_slot;
+
+static t_popen_slot g_slots[FT_POPEN_MAX_FD];
+
+static int reap_child(pid_t pid, int *status)
+{
+    while(waitpid(pid, status, 0) == -1)
+    {
+        if(errno != EINTR)
+            return(-1);
+    }
+    return(0);
+}
+
+// reap is how ft_pclose collects the status, NULL for our own children.
+// A child that cannot get a slot is killed and reaped.
+int ft_popen_register_with(int fd, pid_t pid, t_reaper reap)
+{
+    int status;
+
+    if(!reap)
+        reap = reap_child;
+    if(fd < 0 || fd >= FT_POPEN_MAX_FD)
+    {
+        if(fd >= 0)
+            close(fd);
+        kill(pid, SIGKILL);
+        reap(pid, &status);
+        errno = (fd < 0) ? EBADF : EMFILE;
+        return(-1);
+    }
+    g_slots[fd].pid = pid;
+    g_slots[fd].pidfd = -1;
+    g_slots[fd].timedout = 0;
+    g_slots[fd].deadline = 0;
+    g_slots[fd].reap = reap;
+    return(fd);
+}
+
+int ft_popen_register(int fd, pid_t pid)
+{
+    return(ft_popen_register_with(fd, pid, NULL));
+}
 
 int ft_popen(const char *file, char *const argv[], char type)
 {
+    return(ft_popen_ex(file, argv, type, NULL));
+}
+
+int ft_popen_ex(const char *file, char *const argv[], char type,
+    const t_popen_opts *opts)
+{
+    t_spawn sp;
     int fd[2];
+    int pidfd;
     pid_t pid;
     if(!file || !argv || (type != 'r' && type != 'w'))
         return(-1);
     
-    if(pipe(fd)== -1)
+    if(pipe2(fd, O_CLOEXEC)== -1)
         return(-1);
+    if(opts && opts->pipe_size)
+        ft_pipe_set_size(fd[0], opts->pipe_size);
 
-    pid = fork();
+    sp.file = file;
+    sp.argv = argv;
+    sp.pidfd = NULL;
+    if(opts && ((opts->flags & FT_POPEN_PIDFD) || opts->deadline_ms > 0))
+        sp.pidfd = &pidfd;
+    sp.check_exec = (opts && (opts->flags & FT_POPEN_EXECERR));
+    sp.in = (type == 'w') ? fd[0] : -1;
+    sp.out = (type == 'r') ? fd[1] : -1;
+    pid = ft_spawn(ft_popen_get_spawn(), &sp);
     if(pid == -1)
     {
         close(fd[0]);
         close(fd[1]);
         return(-1);
     }
-    if(pid == 0)
+    if(type == 'r')
     {
-        if(type == 'r')
-        {
-            if(dup2(fd[1], STDOUT_FILENO) == -1)
-                exit(1);
-        }
-        else
-        {
-            if(dup2(fd[0], STDIN_FILENO) == -1)
-                exit(1);
-        }
-        close(fd[0]);
         close(fd[1]);
-        execvp(file, argv);
-        exit(1);
+        fd[1] = fd[0];
     }
     else
+        close(fd[0]);
+    // a deadline is only enforced through the pidfd: without one (no
+    // pidfd_open on this kernel) the child could outlive it unnoticed
+    if(opts && opts->deadline_ms > 0 && pidfd == -1)
     {
-        if(type == 'r')
-        {
-            close(fd[1]);
-            return(fd[0]);
-        }
-        else
-        {
-            close(fd[0]);
-            return(fd[1]);
-        }
+        close(fd[1]);
+        kill(pid, SIGKILL);
+        reap_child(pid, &pidfd);
+        errno = ENOSYS;
+        return(-1);
     }
+    if(opts && (opts->flags & FT_POPEN_NONBLOCK))
+        fcntl(fd[1], F_SETFL, fcntl(fd[1], F_GETFL) | O_NONBLOCK);
+    if(ft_popen_register(fd[1], pid) == -1)
+    {
+        if(sp.pidfd && pidfd != -1)
+            close(pidfd);
+        return(-1);
+    }
+    if(sp.pidfd)
+        g_slots[fd[1]].pidfd = pidfd;
+    if(sp.pidfd && opts->deadline_ms > 0)
+        g_slots[fd[1]].deadline = ft_now_ms() + opts->deadline_ms;
+    return(fd[1]);
+}
+
+pid_t ft_popen_pid(int fd)
+{
+    if(fd < 0 || fd >= FT_POPEN_MAX_FD)
+        return(0);
+    return(g_slots[fd].pid);
+}
+
+// -1 unless the stream was opened with FT_POPEN_PIDFD (and the kernel
+// has pidfds); the pidfd stays owned by the stream until ft_pclose
+int ft_popen_pidfd(int fd)
+{
+    if(ft_popen_pid(fd) <= 0)
+        return(-1);
+    return(g_slots[fd].pidfd);
+}
+
+// ms left before the stream's deadline, -1 when it has none
+static int popen_time_left(const t_popen_slot *slot)
+{
+    long left;
+
+    if(!slot->deadline)
+        return(-1);
+    left = slot->deadline - ft_now_ms();
+    return(left > 0 ? (int)left : 0);
+}
+
+// waits until fd is ready or the deadline passes, then kills the child
+static int popen_wait_io(int fd, short events)
+{
+    t_popen_slot *slot;
+    struct pollfd pfd;
+    int n;
+
+    if(ft_popen_pid(fd) <= 0 || !g_slots[fd].deadline)
+        return(0);
+    slot = &g_slots[fd];
+    pfd.fd = fd;
+    pfd.events = events;
+    n = 0;
+    while(!slot->timedout
+        && (n = poll(&pfd, 1, popen_time_left(slot))) == -1 && errno == EINTR)
+        ;
+    if(n > 0)
+        return(0);
+    if(n == 0 && !slot->timedout)
+    {
+        ft_pidfd_kill(slot->pidfd, SIGKILL);
+        slot->timedout = 1;
+    }
+    if(slot->timedout)
+        errno = ETIMEDOUT;
+    return(-1);
+}
+
+// read/write that honour the stream's deadline, plain read/write otherwise
+ssize_t ft_popen_read(int fd, void *buf, size_t n)
+{
+    if(popen_wait_io(fd, POLLIN) == -1)
+        return(-1);
+    return(read(fd, buf, n));
+}
+
+ssize_t ft_popen_write(int fd, const void *buf, size_t n)
+{
+    if(popen_wait_io(fd, POLLOUT) == -1)
+        return(-1);
+    return(write(fd, buf, n));
+}
+
+// close the stream and reap its child, returns the wait status
+// (like pclose) or -1 with EBADF if fd did not come from ft_popen.
+// A stream with a deadline waits at most until then, see FT_WTIMEDOUT.
+int ft_pclose(int fd)
+{
+    t_popen_slot slot;
+    int status;
+    int timedout;
+
+    if(ft_popen_pid(fd) <= 0)
+    {
+        errno = EBADF;
+        return(-1);
+    }
+    slot = g_slots[fd];
+    g_slots[fd].pid = 0;
+    close(fd);
+    if(slot.pidfd != -1 && slot.deadline)
+    {
+        timedout = ft_pidfd_wait_kill(slot.pidfd, popen_time_left(&slot),
+            &status);
+        if(timedout == -1)
+            return(-1);
+        if(timedout == FT_PIDFD_TIMEOUT || slot.timedout)
+            status |= FT_POPEN_TIMEDOUT;
+        return(status);
+    }
+    if(slot.pidfd != -1)
+    {
+        if(ft_pidfd_reap(slot.pidfd, &status) == -1)
+            return(-1);
+        return(status);
+    }
+    if(slot.reap(slot.pid, &status) == -1)
+        return(-1);
+    return(status);
 }
@@ -0,0 +1,220 @@
+#ifndef FT_POPEN_H
+# define FT_POPEN_H
+
+# include <sys/types.h>
+
+// Spawn backends, i.e. how the child is created before it execs:
+//  FT_SPAWN_FORK   plain fork(), copies the parent's page tables
+//  FT_SPAWN_VFORK  vfork(), the parent sleeps until the child execs
+//  FT_SPAWN_POSIX  posix_spawnp(), falls back to fork() when it cannot exec
+//  FT_SPAWN_CLONE  clone(CLONE_VM | CLONE_VFORK) on a private stack
+// The default comes from -DFT_POPEN_SPAWN=... and can be overridden at
+// run time with ft_popen_set_spawn() or FT_POPEN_SPAWN=fork|vfork|posix|clone
+# define FT_SPAWN_FORK  0
+# define FT_SPAWN_VFORK 1
+# define FT_SPAWN_POSIX 2
+# define FT_SPAWN_CLONE 3
+
+# ifndef FT_POPEN_SPAWN
+#  define FT_POPEN_SPAWN FT_SPAWN_FORK
+# endif
+
+// Size of the fd-indexed table that remembers which child sits behind
+// each stream. ft_popen fails with EMFILE on a pipe fd past this bound.
+# ifndef FT_POPEN_MAX_FD
+#  define FT_POPEN_MAX_FD 65536
+# endif
+
+// Extra knobs for ft_popen_ex(), a NULL opts behaves like ft_popen().
+// flags: FT_POPEN_NONBLOCK returns the stream with O_NONBLOCK set.
+//        FT_POPEN_PIDFD keeps a pidfd for the child, see ft_popen_pidfd().
+//        FT_POPEN_EXECERR makes a failed exec fail ft_popen_ex itself:
+//        -1 with the child's errno (ENOENT, EACCES...) and nothing to
+//        reap, instead of a stream that just hits EOF / SIGPIPE.
+// pipe_size: pipe capacity in bytes (F_SETPIPE_SZ), 0 keeps the kernel
+// default, larger values are clamped to /proc/sys/fs/pipe-max-size.
+// deadline_ms: how long the child may live, 0 for no limit. Enforced by
+// ft_popen_read/ft_popen_write and ft_pclose through the child's pidfd,
+// no signal handler involved: past it the child is SIGKILLed, I/O fails
+// with ETIMEDOUT and ft_pclose's status has FT_POPEN_TIMEDOUT set.
+# define FT_POPEN_NONBLOCK 0x1
+# define FT_POPEN_PIDFD    0x2
+# define FT_POPEN_EXECERR  0x4
+
+// Never produced by wait(): set on top of the SIGKILL status, so a
+// caller that only checks WIFSIGNALED still sees the child was killed
+# define FT_POPEN_TIMEDOUT 0x10000
+# define FT_WTIMEDOUT(st)  ((st) != -1 && ((st) & FT_POPEN_TIMEDOUT))
+
+typedef struct s_popen_opts
+{
+    int     flags;
+    size_t  pipe_size;
+    long    deadline_ms;
+}   t_popen_opts;
+
+// What ft_popen_drain() did: bytes moved, wall time, and which path
+// carried them (FT_DRAIN_SPLICE, FT_DRAIN_SENDFILE or FT_DRAIN_COPY).
+# define FT_DRAIN_SPLICE   0
+# define FT_DRAIN_SENDFILE 1
+# define FT_DRAIN_COPY     2
+
+typedef struct s_drain_stats
+{
+    size_t  bytes;
+    long    elapsed_ns;
+    int     method;
+}   t_drain_stats;
+
+// Collects the wait status of a stream's child for ft_pclose, 0 or -1.
+// Streams whose child is not ours (zygote mode) register their own.
+typedef int (*t_reaper)(pid_t pid, int *status);
+
+// Event loop over many non-blocking streams, one epoll set, one thread.
+// on_readable/on_writable fire while the fd is ready (level-triggered),
+// NULL ones are not watched. on_eof fires once when the other side is
+// gone (hangup with no data left, or error): the fd has already been
+// removed from the loop, so on_eof usually just calls ft_pclose().
+typedef struct s_popen_events
+{
+    void    (*on_readable)(int fd, void *ctx);
+    void    (*on_writable)(int fd, void *ctx);
+    void    (*on_eof)(int fd, void *ctx);
+}   t_popen_events;
+
+typedef struct s_popen_loop t_popen_loop;
+
+// One entry per command of ft_popen_many(): everything it printed on
+// stdout (malloc'd, NUL-terminated, free() it) and its wait status,
+// status is -1 and out NULL when the command could not be started.
+// truncated is only ever set by ft_popen_capture(), see there.
+typedef struct s_popen_result
+{
+    char    *out;
+    size_t  len;
+    int     status;
+    int     truncated;
+}   t_popen_result;
+
+// Output cache of ft_popen_cached(): FT_POPEN_CACHE_SLOTS direct-mapped
+// entries holding at most FT_POPEN_CACHE_BYTES (see ft_popen_cache_limit).
+# ifndef FT_POPEN_CACHE_SLOTS
+#  define FT_POPEN_CACHE_SLOTS 64
+# endif
+# ifndef FT_POPEN_CACHE_BYTES
+#  define FT_POPEN_CACHE_BYTES (1024 * 1024)
+# endif
+
+typedef struct s_popen_cache_stats
+{
+    unsigned long   hits;
+    unsigned long   misses;
+    size_t          bytes;
+    size_t          entries;
+}   t_popen_cache_stats;
+
+// Buffered line reader over any stream. ft_lr_next() hands out (ptr, len)
+// views into one reusable buffer, without the '\n': no copy, no malloc
+// per line, and a view only lives until the next ft_lr_next() call.
+// Newlines are found 32 (AVX2) or 16 (SSE2) bytes at a time when the CPU
+// has it, byte by byte otherwise.
+typedef struct s_line
+{
+    const char  *ptr;
+    size_t      len;
+}   t_line;
+
+typedef struct s_linereader
+{
+    int     fd;
+    char    *buf;
+    size_t  cap;
+    size_t  start;
+    size_t  scan;
+    size_t  end;
+    int     eof;
+}   t_linereader;
+
+// What the child needs: the command and the fds it gets wired to.
+// in/out land on the child's stdin/stdout (-1 keeps the inherited one).
+// Every other fd past stderr is closed when the child execs.
+// pidfd, when not NULL, receives a pidfd for the child or -1.
+// check_exec makes ft_spawn() fail with the child's errno if exec fails.
+typedef struct s_spawn
+{
+    const char  *file;
+    char *const *argv;
+    int         in;
+    int         out;
+    int         *pidfd;
+    int         check_exec;
+}   t_spawn;
+
+int     ft_popen(const char *file, char *const argv[], char type);
+int     ft_popen_ex(const char *file, char *const argv[], char type,
+            const t_popen_opts *opts);
+int     ft_pclose(int fd);
+ssize_t ft_popen_read(int fd, void *buf, size_t n);
+ssize_t ft_popen_write(int fd, const void *buf, size_t n);
+pid_t   ft_popen_pid(int fd);
+int     ft_popen_pidfd(int fd);
+int     ft_popen_register(int fd, pid_t pid);
+int     ft_popen_register_with(int fd, pid_t pid, t_reaper reap);
+
+// Coprocess: fd[0] reads the child's stdout, fd[1] writes its stdin.
+// Never block writing fd[1] while the child blocks writing fd[0]: either
+// use ft_popen2_pump(), or poll() both ends and keep reading while you
+// write. Close fd[1] to send EOF, then ft_pclose(fd[0]) to reap.
+int     ft_popen2(const char *file, char *const argv[], int fd[2]);
+ssize_t ft_popen2_pump(int fd[2], const void *in, size_t len, char **out);
+
+ssize_t ft_popen_drain(int fd, int out_fd, t_drain_stats *stats);
+
+// Zero-copy feed of a 'w' stream: buf's pages are gifted to the pipe and
+// must stay untouched until the child has read them, see the reuse rule
+// in ft_popen_vmsplice.c. That rule assumes the child read()s its stdin;
+// one that splice()s it elsewhere keeps the pages past ft_popen_pending
+// reaching 0, so use ft_popen_write for children you do not control.
+ssize_t ft_popen_vmsplice(int fd, const void *buf, size_t len);
+int     ft_popen_pending(int fd);
+
+// Zygote mode: ft_zygote_start() forks a small helper, ideally early
+// while our heap is still small. ft_zygote_popen() then behaves like
+// ft_popen(), but the child is forked from the helper's image and the
+// pipe end comes back over a Unix socket; ft_pclose() works as usual.
+// The helper keeps the environment it had when it was started.
+int     ft_zygote_start(void);
+int     ft_zygote_popen(const char *file, char *const argv[], char type);
+void    ft_zygote_stop(void);
+
+t_popen_loop    *ft_loop_new(void);
+int             ft_loop_add(t_popen_loop *loop, int fd,
+                    const t_popen_events *ev, void *ctx);
+int             ft_loop_del(t_popen_loop *loop, int fd);
+int             ft_loop_run(t_popen_loop *loop, int timeout_ms);
+void            ft_loop_free(t_popen_loop *loop);
+
+int     ft_popen_memfd(const char *file, char *const argv[], size_t *size,
+            int *status);
+int     ft_popen_many(char **const cmds[], size_t n, size_t max_parallel,
+            t_popen_result *results);
+int     ft_popen_capture(const char *file, char *const argv[], size_t cap,
+            t_popen_result *res);
+
+int     ft_popen_cached(char *const argv[], long ttl_ms, t_popen_result *res);
+void    ft_popen_cache_limit(size_t max_bytes);
+void    ft_popen_cache_stats(t_popen_cache_stats *stats);
+void    ft_popen_cache_flush(void);
+
+int     ft_lr_init(t_linereader *lr, int fd, size_t cap);
+int     ft_lr_next(t_linereader *lr, t_line *line);
+void    ft_lr_free(t_linereader *lr);
+
+long    ft_pipe_max_size(void);
+long    ft_pipe_set_size(int fd, size_t size);
+
+int     ft_popen_set_spawn(int backend);
+int     ft_popen_get_spawn(void);
+pid_t   ft_spawn(int backend, const t_spawn *sp);
+
+#endif
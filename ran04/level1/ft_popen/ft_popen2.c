@@ -0,0 +1,191 @@
+#define _GNU_SOURCE
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/types.h>
+#include "ft_popen.h"
+
+// two pipes: in[] feeds the child's stdin, out[] carries its stdout
+int ft_popen2(const char *file, char *const argv[], int fd[2])
+{
+    t_spawn sp;
+    int in[2];
+    int out[2];
+    pid_t pid;
+
+    if(!file || !argv || !fd)
+        return(-1);
+    if(pipe2(in, O_CLOEXEC) == -1)
+        return(-1);
+    if(pipe2(out, O_CLOEXEC) == -1)
+    {
+        close(in[0]);
+        close(in[1]);
+        return(-1);
+    }
+    sp.file = file;
+    sp.argv = argv;
+    sp.pidfd = NULL;
+    sp.check_exec = 0;
+    sp.in = in[0];
+    sp.out = out[1];
+    pid = ft_spawn(ft_popen_get_spawn(), &sp);
+    close(in[0]);
+    close(out[1]);
+    if(pid == -1)
+    {
+        close(in[1]);
+        close(out[0]);
+        return(-1);
+    }
+    if(ft_popen_register(out[0], pid) == -1)
+    {
+        close(in[1]);
+        return(-1);
+    }
+    fd[0] = out[0];
+    fd[1] = in[1];
+    return(0);
+}
+
+static int pump_grow(char **out, size_t *cap, size_t len)
+{
+    char *tmp;
+
+    if(len < *cap)
+        return(0);
+    *cap = *cap ? *cap * 2 : 65536;
+    tmp = realloc(*out, *cap);
+    if(!tmp)
+        return(-1);
+    *out = tmp;
+    return(0);
+}
+
+// SIGPIPE is blocked for the pump, so a child that exits before taking
+// all of its input (head -c 10) makes write() fail with EPIPE instead of
+// killing us. That only ends the input: the output is still read to EOF.
+typedef struct s_pump
+{
+    sigset_t    pipe_set;
+    sigset_t    old;
+    int         epipe;
+}   t_pump;
+
+static void pump_block(t_pump *p)
+{
+    sigemptyset(&p->pipe_set);
+    sigaddset(&p->pipe_set, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &p->pipe_set, &p->old);
+    p->epipe = 0;
+}
+
+// the SIGPIPE our own EPIPE left pending is consumed before unblocking,
+// unless the caller had it blocked already and so gets it as before
+static void pump_end(int fd[2], t_pump *p)
+{
+    static const struct timespec now = {0, 0};
+
+    if(fd[1] != -1)
+        close(fd[1]);
+    fd[1] = -1;
+    if(p->epipe && !sigismember(&p->old, SIGPIPE))
+        sigtimedwait(&p->pipe_set, NULL, &now);
+    pthread_sigmask(SIG_SETMASK, &p->old, NULL);
+}
+
+static int pump_write(int fd[2], const char *in, size_t len, size_t *sent,
+    t_pump *p)
+{
+    ssize_t n;
+
+    n = write(fd[1], in + *sent, len - *sent);
+    if(n == -1 && errno == EPIPE)
+    {
+        p->epipe = 1;
+        *sent = len;
+    }
+    else if(n == -1 && errno != EAGAIN && errno != EINTR)
+        return(-1);
+    else if(n > 0)
+        *sent += n;
+    if(*sent == len)
+    {
+        close(fd[1]);
+        fd[1] = -1;
+    }
+    return(0);
+}
+
+// Writes len bytes of in to the child and collects everything it prints
+// into *out (malloc'd, caller frees). Both directions are driven by one
+// poll() loop, so neither side can fill its pipe while the other waits:
+// this is the deadlock-free way to push large payloads through a filter.
+// If the child stops reading early the rest of in is dropped. fd[1] is
+// closed (and set to -1) on return. Returns the output size or -1.
+ssize_t ft_popen2_pump(int fd[2], const void *in, size_t len, char **out)
+{
+    struct pollfd pfd[2];
+    t_pump p;
+    size_t sent;
+    size_t got;
+    size_t cap;
+    ssize_t n;
+
+    *out = NULL;
+    sent = 0;
+    got = 0;
+    cap = 0;
+    pump_block(&p);
+    if(fcntl(fd[1], F_SETFL, fcntl(fd[1], F_GETFL) | O_NONBLOCK) == -1)
+    {
+        pump_end(fd, &p);
+        return(-1);
+    }
+    if(len == 0)
+    {
+        close(fd[1]);
+        fd[1] = -1;
+    }
+    while(1)
+    {
+        pfd[0].fd = fd[0];
+        pfd[0].events = POLLIN;
+        pfd[1].fd = fd[1];
+        pfd[1].events = POLLOUT;
+        if(poll(pfd, 2, -1) == -1)
+        {
+            if(errno == EINTR)
+                continue;
+            break;
+        }
+        if((pfd[1].revents & (POLLOUT | POLLERR))
+            && pump_write(fd, in, len, &sent, &p) == -1)
+            break;
+        if(pfd[0].revents & (POLLIN | POLLHUP))
+        {
+            if(pump_grow(out, &cap, got) == -1)
+                break;
+            n = read(fd[0], *out + got, cap - got);
+            if(n == 0)
+            {
+                pump_end(fd, &p);
+                return(got);
+            }
+            if(n == -1 && errno != EINTR)
+                break;
+            if(n > 0)
+                got += n;
+        }
+    }
+    pump_end(fd, &p);
+    free(*out);
+    *out = NULL;
+    return(-1);
+}
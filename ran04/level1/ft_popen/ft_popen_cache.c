@@ -0,0 +1,244 @@
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "ft_popen.h"
+#include "../common/ft_pidfd.h"
+
+// argv flattened as "arg0\0arg1\0...": two argvs are the same command
+// exactly when their keys have the same bytes and length
+typedef struct s_cache_entry
+{
+    char    *key;
+    size_t  klen;
+    char    *out;
+    size_t  len;
+    long    expires;
+}   t_cache_entry;
+
+// direct-mapped like the PATH cache: a collision replaces the older entry
+static t_cache_entry g_cache[FT_POPEN_CACHE_SLOTS];
+static size_t g_bytes = 0;
+static size_t g_limit = FT_POPEN_CACHE_BYTES;
+static unsigned long g_hits = 0;
+static unsigned long g_misses = 0;
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static char *cache_key(char *const argv[], size_t *klen)
+{
+    char *key;
+    size_t len;
+    size_t n;
+    int i;
+
+    len = 0;
+    i = -1;
+    while(argv[++i])
+        len += strlen(argv[i]) + 1;
+    key = malloc(len ? len : 1);
+    if(!key)
+        return(NULL);
+    len = 0;
+    i = -1;
+    while(argv[++i])
+    {
+        n = strlen(argv[i]) + 1;
+        memcpy(key + len, argv[i], n);
+        len += n;
+    }
+    *klen = len;
+    return(key);
+}
+
+static unsigned int cache_hash(const char *key, size_t klen)
+{
+    unsigned int h;
+
+    h = 5381;
+    while(klen--)
+        h = h * 33 + (unsigned char)*key++;
+    return(h % FT_POPEN_CACHE_SLOTS);
+}
+
+// under g_lock
+static void entry_clear(t_cache_entry *e)
+{
+    g_bytes -= e->klen + e->len;
+    free(e->key);
+    free(e->out);
+    memset(e, 0, sizeof(*e));
+}
+
+// under g_lock: expired entries go first, then the ones closest to expiry
+static void cache_make_room(size_t need, long now)
+{
+    t_cache_entry *victim;
+    int i;
+
+    i = -1;
+    while(++i < FT_POPEN_CACHE_SLOTS)
+    {
+        if(g_cache[i].key && g_cache[i].expires <= now)
+            entry_clear(&g_cache[i]);
+    }
+    while(g_bytes + need > g_limit)
+    {
+        victim = NULL;
+        i = -1;
+        while(++i < FT_POPEN_CACHE_SLOTS)
+        {
+            if(g_cache[i].key
+                && (!victim || g_cache[i].expires < victim->expires))
+                victim = &g_cache[i];
+        }
+        if(!victim)
+            return;
+        entry_clear(victim);
+    }
+}
+
+// copies the entry out while it is still fresh, 0 on a hit
+static int cache_lookup(const char *key, size_t klen, t_popen_result *res)
+{
+    t_cache_entry *e;
+    int hit;
+
+    hit = 0;
+    pthread_mutex_lock(&g_lock);
+    e = &g_cache[cache_hash(key, klen)];
+    if(e->key && e->klen == klen && memcmp(e->key, key, klen) == 0)
+    {
+        if(e->expires > ft_now_ms())
+        {
+            res->out = malloc(e->len + 1);
+            if(res->out)
+            {
+                memcpy(res->out, e->out, e->len + 1);
+                res->len = e->len;
+                hit = 1;
+            }
+        }
+        else
+            entry_clear(e);
+    }
+    if(hit)
+        g_hits++;
+    else
+        g_misses++;
+    pthread_mutex_unlock(&g_lock);
+    return(hit ? 0 : -1);
+}
+
+// takes ownership of key, copies the output
+static void cache_store(char *key, size_t klen, const t_popen_result *res,
+    long ttl_ms)
+{
+    t_cache_entry *e;
+    char *out;
+    long now;
+
+    out = (klen + res->len <= g_limit) ? malloc(res->len + 1) : NULL;
+    if(!out)
+    {
+        free(key);
+        return;
+    }
+    memcpy(out, res->out, res->len + 1);
+    pthread_mutex_lock(&g_lock);
+    now = ft_now_ms();
+    e = &g_cache[cache_hash(key, klen)];
+    if(e->key)
+        entry_clear(e);
+    cache_make_room(klen + res->len, now);
+    if(g_bytes + klen + res->len > g_limit)
+    {
+        free(key);
+        free(out);
+    }
+    else
+    {
+        e->key = key;
+        e->klen = klen;
+        e->out = out;
+        e->len = res->len;
+        e->expires = now + ttl_ms;
+        g_bytes += klen + res->len;
+    }
+    pthread_mutex_unlock(&g_lock);
+}
+
+// Opt-in memoization for idempotent commands (uname -r, nproc...): while
+// an entry for this exact argv is younger than ttl_ms, res gets a copy of
+// its output and a 0 status without forking. Otherwise the command runs
+// like one ft_popen_many() entry and is cached only if it exited with 0.
+// A ttl_ms <= 0 just runs the command. Returns 0 or -1 like ft_popen_many.
+int ft_popen_cached(char *const argv[], long ttl_ms, t_popen_result *res)
+{
+    char **const cmd[1] = {(char **)argv};
+    size_t klen;
+    char *key;
+
+    if(!argv || !argv[0] || !res)
+        return(-1);
+    res->out = NULL;
+    res->len = 0;
+    res->status = 0;
+    res->truncated = 0;
+    key = NULL;
+    if(ttl_ms > 0)
+        key = cache_key(argv, &klen);
+    if(key && cache_lookup(key, klen, res) == 0)
+    {
+        free(key);
+        return(0);
+    }
+    if(ft_popen_many(cmd, 1, 1, res) == -1 || res->status != 0 || !key)
+    {
+        free(key);
+        return(res->status == -1 ? -1 : 0);
+    }
+    cache_store(key, klen, res, ttl_ms);
+    return(0);
+}
+
+// caps the bytes (keys + outputs) the cache holds, shrinking it right away
+void ft_popen_cache_limit(size_t max_bytes)
+{
+    pthread_mutex_lock(&g_lock);
+    g_limit = max_bytes;
+    cache_make_room(0, ft_now_ms());
+    pthread_mutex_unlock(&g_lock);
+}
+
+void ft_popen_cache_stats(t_popen_cache_stats *stats)
+{
+    int i;
+
+    pthread_mutex_lock(&g_lock);
+    stats->hits = g_hits;
+    stats->misses = g_misses;
+    stats->bytes = g_bytes;
+    stats->entries = 0;
+    i = -1;
+    while(++i < FT_POPEN_CACHE_SLOTS)
+    {
+        if(g_cache[i].key)
+            stats->entries++;
+    }
+    pthread_mutex_unlock(&g_lock);
+}
+
+// drops every entry, the hit/miss counters keep counting
+void ft_popen_cache_flush(void)
+{
+    int i;
+
+    pthread_mutex_lock(&g_lock);
+    i = -1;
+    while(++i < FT_POPEN_CACHE_SLOTS)
+    {
+        if(g_cache[i].key)
+            entry_clear(&g_cache[i]);
+    }
+    pthread_mutex_unlock(&g_lock);
+}
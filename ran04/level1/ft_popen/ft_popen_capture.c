@@ -0,0 +1,96 @@
+#include <unistd.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <signal.h>
+#include "ft_popen.h"
+#include "../common/ft_pidfd.h"
+
+#define FT_CAPTURE_CHUNK 4096
+
+// grows res->out towards cap + 1 (room for the '\0'), never past it
+static int capture_grow(t_popen_result *res, size_t *size, size_t cap)
+{
+    size_t want;
+    char *tmp;
+
+    want = *size ? *size * 2 : FT_CAPTURE_CHUNK;
+    if(want > cap + 1)
+        want = cap + 1;
+    tmp = realloc(res->out, want);
+    if(!tmp)
+        return(-1);
+    res->out = tmp;
+    *size = want;
+    return(0);
+}
+
+// Past the cap we only need to know whether one more byte exists: if it
+// does the child is killed and the pipe closed with whatever is left in
+// it, so a grandchild that still holds stdout cannot keep us reading.
+static void capture_cut(int fd, t_popen_result *res)
+{
+    char c;
+    ssize_t n;
+
+    while((n = read(fd, &c, 1)) == -1 && errno == EINTR)
+        ;
+    if(n <= 0)
+        return;
+    res->truncated = 1;
+    if(ft_pidfd_kill(ft_popen_pidfd(fd), SIGKILL) == -1)
+        kill(ft_popen_pid(fd), SIGKILL);
+}
+
+// Like one ft_popen_many() entry, but keeps at most cap bytes of the
+// child's stdout in memory. A child that writes more is SIGKILLed as soon
+// as the cap is reached and res->truncated is set, res->status then holds
+// the SIGKILL status. Returns 0, or -1 if the child could not be started
+// or the buffer could not be allocated (the child is killed and reaped).
+int ft_popen_capture(const char *file, char *const argv[], size_t cap,
+    t_popen_result *res)
+{
+    t_popen_opts opts = {FT_POPEN_PIDFD, 0, 0};
+    size_t size;
+    ssize_t n;
+    int err;
+    int fd;
+
+    if(!res)
+        return(-1);
+    res->out = NULL;
+    res->len = 0;
+    res->status = -1;
+    res->truncated = 0;
+    fd = ft_popen_ex(file, argv, 'r', &opts);
+    if(fd == -1)
+        return(-1);
+    size = 0;
+    err = capture_grow(res, &size, cap);
+    n = 1;
+    while(!err && n != 0 && res->len < cap)
+    {
+        if(size - res->len < 2)
+            err = capture_grow(res, &size, cap);
+        if(err)
+            break;
+        n = read(fd, res->out + res->len, size - res->len - 1);
+        if(n == -1 && errno != EINTR)
+            err = -1;
+        else if(n > 0)
+            res->len += n;
+    }
+    if(err && ft_pidfd_kill(ft_popen_pidfd(fd), SIGKILL) == -1)
+        kill(ft_popen_pid(fd), SIGKILL);
+    else if(!err && res->len == cap)
+        capture_cut(fd, res);
+    res->status = ft_pclose(fd);
+    if(err)
+    {
+        free(res->out);
+        res->out = NULL;
+        res->len = 0;
+        return(-1);
+    }
+    res->out[res->len] = '\0';
+    return(0);
+}
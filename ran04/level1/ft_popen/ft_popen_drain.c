@@ -0,0 +1,105 @@
+#define _GNU_SOURCE
+#include <unistd.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/sendfile.h>
+#include "ft_popen.h"
+
+#define FT_DRAIN_CHUNK (1024 * 1024)
+
+static long now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return(ts.tv_sec * 1000000000L + ts.tv_nsec);
+}
+
+static ssize_t drain_copy(int fd, int out_fd, size_t *moved)
+{
+    char *buf;
+    ssize_t n;
+    ssize_t w;
+    ssize_t off;
+
+    buf = malloc(FT_DRAIN_CHUNK);
+    if(!buf)
+        return(-1);
+    while((n = read(fd, buf, FT_DRAIN_CHUNK)) != 0)
+    {
+        if(n == -1 && errno == EINTR)
+            continue;
+        if(n == -1)
+            break;
+        off = 0;
+        while(off < n)
+        {
+            w = write(out_fd, buf + off, n - off);
+            if(w == -1 && errno == EINTR)
+                continue;
+            if(w == -1)
+                break;
+            off += w;
+        }
+        *moved += off;
+        if(off < n)
+        {
+            n = -1;
+            break;
+        }
+    }
+    free(buf);
+    return(n);
+}
+
+// One syscall per chunk: splice when out_fd supports it, sendfile next,
+// plain read/write otherwise. 1 = moved something, 0 = EOF, -1 = error,
+// -2 = this path is not supported for the pair and nothing was moved.
+static ssize_t drain_step(int fd, int out_fd, int method)
+{
+    ssize_t n;
+
+    if(method == FT_DRAIN_SPLICE)
+        n = splice(fd, NULL, out_fd, NULL, FT_DRAIN_CHUNK, SPLICE_F_MOVE | SPLICE_F_MORE);
+    else
+        n = sendfile(out_fd, fd, NULL, FT_DRAIN_CHUNK);
+    if(n == -1 && (errno == EINVAL || errno == ENOSYS))
+        return(-2);
+    return(n);
+}
+
+// Moves everything the child writes on fd into out_fd without bouncing
+// through user space when the kernel allows it. Returns the number of
+// bytes moved or -1, stats (optional) also gets the time and the path.
+ssize_t ft_popen_drain(int fd, int out_fd, t_drain_stats *stats)
+{
+    t_drain_stats st;
+    long start;
+    ssize_t n;
+
+    start = now_ns();
+    st.bytes = 0;
+    st.method = FT_DRAIN_SPLICE;
+    n = 1;
+    while(st.method != FT_DRAIN_COPY && n != 0)
+    {
+        n = drain_step(fd, out_fd, st.method);
+        if(n == -2 && st.bytes == 0)
+            st.method++;
+        else if(n == -2 || (n == -1 && errno != EINTR))
+            break;
+        else if(n > 0)
+            st.bytes += n;
+    }
+    if(st.method == FT_DRAIN_COPY)
+        n = drain_copy(fd, out_fd, &st.bytes);
+    st.elapsed_ns = now_ns() - start;
+    if(stats)
+        *stats = st;
+    if(n < 0)
+        return(-1);
+    return(st.bytes);
+}
@@ -0,0 +1,168 @@
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/epoll.h>
+#include "ft_popen.h"
+
+#define FT_LOOP_BATCH 64
+
+typedef struct s_loop_reg
+{
+    t_popen_events  ev;
+    void            *ctx;
+}   t_loop_reg;
+
+// regs is indexed by fd, like the ft_popen slot table, and grows on demand
+struct s_popen_loop
+{
+    int         epfd;
+    int         count;
+    int         size;
+    t_loop_reg  **regs;
+};
+
+t_popen_loop *ft_loop_new(void)
+{
+    t_popen_loop *loop;
+
+    loop = calloc(1, sizeof(*loop));
+    if(!loop)
+        return(NULL);
+    loop->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if(loop->epfd == -1)
+    {
+        free(loop);
+        return(NULL);
+    }
+    return(loop);
+}
+
+static int loop_grow(t_popen_loop *loop, int fd)
+{
+    t_loop_reg **tmp;
+    int size;
+
+    if(fd < loop->size)
+        return(0);
+    size = loop->size ? loop->size : 64;
+    while(size <= fd)
+        size *= 2;
+    tmp = realloc(loop->regs, size * sizeof(*tmp));
+    if(!tmp)
+        return(-1);
+    memset(tmp + loop->size, 0, (size - loop->size) * sizeof(*tmp));
+    loop->regs = tmp;
+    loop->size = size;
+    return(0);
+}
+
+int ft_loop_add(t_popen_loop *loop, int fd, const t_popen_events *ev, void *ctx)
+{
+    struct epoll_event ee;
+    t_loop_reg *reg;
+
+    if(fd < 0 || !ev || loop_grow(loop, fd) == -1)
+        return(-1);
+    if(loop->regs[fd])
+    {
+        errno = EEXIST;
+        return(-1);
+    }
+    reg = malloc(sizeof(*reg));
+    if(!reg)
+        return(-1);
+    reg->ev = *ev;
+    reg->ctx = ctx;
+    memset(&ee, 0, sizeof(ee));
+    ee.events = (ev->on_readable ? EPOLLIN : 0) | (ev->on_writable ? EPOLLOUT : 0);
+    ee.data.fd = fd;
+    if(epoll_ctl(loop->epfd, EPOLL_CTL_ADD, fd, &ee) == -1)
+    {
+        free(reg);
+        return(-1);
+    }
+    loop->regs[fd] = reg;
+    loop->count++;
+    return(0);
+}
+
+int ft_loop_del(t_popen_loop *loop, int fd)
+{
+    if(fd < 0 || fd >= loop->size || !loop->regs[fd])
+    {
+        errno = ENOENT;
+        return(-1);
+    }
+    epoll_ctl(loop->epfd, EPOLL_CTL_DEL, fd, NULL);
+    free(loop->regs[fd]);
+    loop->regs[fd] = NULL;
+    loop->count--;
+    return(0);
+}
+
+// callbacks may add or remove streams, even ones later in the same
+// batch, so events carry the fd and the slot is re-checked after each call
+static void loop_dispatch(t_popen_loop *loop, int fd, unsigned int events)
+{
+    t_loop_reg copy;
+    t_loop_reg *reg;
+
+    if(fd >= loop->size || !loop->regs[fd])
+        return;
+    reg = loop->regs[fd];
+    if((events & EPOLLIN) && reg->ev.on_readable)
+        reg->ev.on_readable(fd, reg->ctx);
+    if(loop->regs[fd] != reg)
+        return;
+    if((events & EPOLLOUT) && !(events & EPOLLERR) && reg->ev.on_writable)
+        reg->ev.on_writable(fd, reg->ctx);
+    if(loop->regs[fd] != reg)
+        return;
+    if((events & EPOLLERR) || ((events & EPOLLHUP) && !(events & EPOLLIN)))
+    {
+        copy = *reg;
+        ft_loop_del(loop, fd);
+        if(copy.ev.on_eof)
+            copy.ev.on_eof(fd, copy.ctx);
+    }
+}
+
+// Runs until every stream hit EOF or was removed (returns 0), or until
+// timeout_ms passes without any event (returns the streams left, -1
+// waits forever). Returns -1 on error.
+int ft_loop_run(t_popen_loop *loop, int timeout_ms)
+{
+    struct epoll_event ev[FT_LOOP_BATCH];
+    int n;
+    int i;
+
+    while(loop->count > 0)
+    {
+        n = epoll_wait(loop->epfd, ev, FT_LOOP_BATCH, timeout_ms);
+        if(n == -1 && errno == EINTR)
+            continue;
+        if(n == -1)
+            return(-1);
+        if(n == 0)
+            return(loop->count);
+        i = -1;
+        while(++i < n)
+            loop_dispatch(loop, ev[i].data.fd, ev[i].events);
+    }
+    return(0);
+}
+
+void ft_loop_free(t_popen_loop *loop)
+{
+    int fd;
+
+    if(!loop)
+        return;
+    fd = -1;
+    while(++fd < loop->size)
+        free(loop->regs[fd]);
+    free(loop->regs);
+    close(loop->epfd);
+    free(loop);
+}
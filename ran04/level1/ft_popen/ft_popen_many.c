@@ -0,0 +1,127 @@
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include "ft_popen.h"
+
+#define FT_MANY_CHUNK 4096
+
+typedef struct s_many
+{
+    struct pollfd   *pfd;
+    size_t          *idx;
+    size_t          *cap;
+    size_t          active;
+}   t_many;
+
+static void many_start(t_many *m, char **const cmd, size_t i, t_popen_result *res)
+{
+    int fd;
+
+    res->out = NULL;
+    res->len = 0;
+    res->status = -1;
+    res->truncated = 0;
+    fd = ft_popen(cmd[0], cmd, 'r');
+    if(fd == -1)
+        return;
+    m->pfd[m->active].fd = fd;
+    m->pfd[m->active].events = POLLIN;
+    m->idx[m->active] = i;
+    m->cap[m->active] = 0;
+    m->active++;
+}
+
+// reads one chunk, returns 0 when the stream is finished
+static int many_read(t_many *m, size_t slot, t_popen_result *res)
+{
+    char *tmp;
+    ssize_t n;
+
+    if(m->cap[slot] - res->len < FT_MANY_CHUNK + 1)
+    {
+        m->cap[slot] = m->cap[slot] ? m->cap[slot] * 2 : FT_MANY_CHUNK * 2;
+        tmp = realloc(res->out, m->cap[slot]);
+        if(!tmp)
+            return(0);
+        res->out = tmp;
+    }
+    n = read(m->pfd[slot].fd, res->out + res->len, m->cap[slot] - res->len - 1);
+    if(n == -1 && errno == EINTR)
+        return(1);
+    if(n <= 0)
+        return(0);
+    res->len += n;
+    return(1);
+}
+
+static void many_finish(t_many *m, size_t slot, t_popen_result *res)
+{
+    res->status = ft_pclose(m->pfd[slot].fd);
+    if(!res->out)
+        res->out = calloc(1, 1);
+    else
+        res->out[res->len] = '\0';
+    m->active--;
+    m->pfd[slot] = m->pfd[m->active];
+    m->idx[slot] = m->idx[m->active];
+    m->cap[slot] = m->cap[m->active];
+}
+
+// Runs every cmds[i] (an argv, cmds[i][0] is the file) with at most
+// max_parallel children alive, and drains all their pipes from a single
+// poll() loop. Returns 0, or -1 if the bookkeeping could not be allocated.
+int ft_popen_many(char **const cmds[], size_t n, size_t max_parallel,
+    t_popen_result *results)
+{
+    t_many m;
+    size_t next;
+    size_t slot;
+    int ret;
+
+    if(!cmds || !results || max_parallel == 0)
+        return(-1);
+    m.pfd = malloc(max_parallel * sizeof(*m.pfd));
+    m.idx = malloc(max_parallel * sizeof(*m.idx));
+    m.cap = malloc(max_parallel * sizeof(*m.cap));
+    m.active = 0;
+    next = 0;
+    ret = (m.pfd && m.idx && m.cap) ? 0 : -1;
+    while(ret == 0 && (next < n || m.active > 0))
+    {
+        while(next < n && m.active < max_parallel)
+        {
+            many_start(&m, cmds[next], next, &results[next]);
+            next++;
+        }
+        if(m.active == 0)
+            continue;
+        if(poll(m.pfd, m.active, -1) == -1)
+        {
+            if(errno != EINTR)
+                ret = -1;
+            continue;
+        }
+        slot = m.active;
+        while(slot-- > 0)
+        {
+            if(m.pfd[slot].revents
+                && !many_read(&m, slot, &results[m.idx[slot]]))
+                many_finish(&m, slot, &results[m.idx[slot]]);
+        }
+    }
+    while(m.active > 0)
+        many_finish(&m, m.active - 1, &results[m.idx[m.active - 1]]);
+    while(next < n)
+    {
+        results[next].out = NULL;
+        results[next].len = 0;
+        results[next].truncated = 0;
+        results[next++].status = -1;
+    }
+    free(m.pfd);
+    free(m.idx);
+    free(m.cap);
+    return(ret);
+}
@@ -0,0 +1,58 @@
+#define _GNU_SOURCE
+#include <unistd.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "ft_popen.h"
+
+// Capture mode: the child's stdout is a memfd instead of a pipe, so there
+// is no pipe capacity to fill and no wakeup per 64 KiB. Runs the command
+// to completion, then returns the memfd rewound to offset 0 with its
+// size in *size and the wait status in *status (may be NULL). The memfd
+// is sealed against writes and resizes, so mmap(NULL, *size, PROT_READ,
+// MAP_SHARED, fd, 0) stays valid even if a grandchild kept stdout open.
+// Returns -1 if the memfd or the child could not be created, or if the
+// seals could not be applied (EBUSY: someone has it mapped writable).
+int ft_popen_memfd(const char *file, char *const argv[], size_t *size,
+    int *status)
+{
+    t_spawn sp;
+    struct stat st;
+    pid_t pid;
+    int wstatus;
+    int fd;
+
+    if(!file || !argv || !size)
+        return(-1);
+    fd = memfd_create("ft_popen", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if(fd == -1)
+        return(-1);
+    sp.file = file;
+    sp.argv = argv;
+    sp.pidfd = NULL;
+    sp.check_exec = 0;
+    sp.in = -1;
+    sp.out = fd;
+    pid = ft_spawn(ft_popen_get_spawn(), &sp);
+    while(pid != -1 && waitpid(pid, &wstatus, 0) == -1)
+    {
+        if(errno != EINTR)
+            pid = -1;
+    }
+    // sealed before the size is read: a grandchild still holding stdout
+    // cannot grow it past *size any more
+    if(pid == -1 || fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW
+            | F_SEAL_WRITE | F_SEAL_SEAL) == -1 || fstat(fd, &st) == -1)
+    {
+        close(fd);
+        return(-1);
+    }
+    lseek(fd, 0, SEEK_SET);
+    *size = st.st_size;
+    if(status)
+        *status = wstatus;
+    return(fd);
+}
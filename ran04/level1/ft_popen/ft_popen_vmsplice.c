@@ -0,0 +1,79 @@
+#define _GNU_SOURCE
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/uio.h>
+#include "ft_popen.h"
+
+// not a pipe (or no vmsplice): same contract, one copy per byte
+static ssize_t feed_write(int fd, const char *buf, size_t len, size_t done)
+{
+    ssize_t n;
+
+    while(done < len)
+    {
+        n = write(fd, buf + done, len - done);
+        if(n == -1 && errno == EINTR)
+            continue;
+        if(n == -1)
+            return(done ? (ssize_t)done : -1);
+        done += n;
+    }
+    return(done);
+}
+
+// Queues len bytes of buf into a 'w' stream by reference instead of by
+// copy: the pipe ends up pointing at buf's pages and the child reads them
+// straight out of our memory. Blocks until everything is queued (or
+// returns the partial count on a non-blocking stream, -1 with EAGAIN if
+// nothing fit). Falls back to write() when fd is not a pipe.
+//
+// buf should be page-aligned and len a multiple of the page size: only
+// whole pages are gifted, and the reuse rule below counts pages.
+// Reuse rule: the pipe keeps referencing buf until the child has read it,
+// so buf must not be modified or freed before one of these holds:
+//  - ft_popen_pending(fd) returned 0, or ft_pclose(fd) returned;
+//  - one full pipe capacity (fcntl F_GETPIPE_SZ) of later data has been
+//    queued behind it: the pipe can only hold that once the child has
+//    consumed buf. Feeding two capacity-sized buffers alternately is
+//    therefore safe, each one is free again when the other was queued.
+// Both only hold if the child copies the data out with read(). A child
+// that splice()s or tee()s its stdin into another pipe or a file moves
+// the references to buf along: the pipe drains, but the pages are still
+// in use until that pipe or the page cache lets go of them, and nothing
+// here can tell when. If the child may do that (cat, pv and others
+// splice when they can), feed it with write() / ft_popen_write instead.
+ssize_t ft_popen_vmsplice(int fd, const void *buf, size_t len)
+{
+    struct iovec iov;
+    size_t done;
+    ssize_t n;
+
+    done = 0;
+    while(done < len)
+    {
+        iov.iov_base = (char *)buf + done;
+        iov.iov_len = len - done;
+        n = vmsplice(fd, &iov, 1, SPLICE_F_GIFT);
+        if(n == -1 && errno == EINTR)
+            continue;
+        if(n == -1 && done == 0 && (errno == EBADF || errno == EINVAL
+            || errno == ENOSYS))
+            return(feed_write(fd, buf, len, 0));
+        if(n == -1)
+            return(done ? (ssize_t)done : -1);
+        done += n;
+    }
+    return(done);
+}
+
+// bytes queued in the stream's pipe that the child has not read yet
+int ft_popen_pending(int fd)
+{
+    int n;
+
+    if(ioctl(fd, FIONREAD, &n) == -1)
+        return(-1);
+    return(n);
+}
@@ -0,0 +1,298 @@
+#define _GNU_SOURCE
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <linux/close_range.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "ft_popen.h"
+#include "../common/ft_pathcache.h"
+#include "../common/ft_pidfd.h"
+
+// Stack for the clone backend, only has to outlive dup2/close/execvp
+#define FT_SPAWN_STACK (64 * 1024)
+
+extern char **environ;
+
+// path is sp->file resolved through the PATH cache, NULL if it was not.
+// exec_errno/errpipe carry an exec failure back when sp->check_exec.
+typedef struct s_spawn_ctx
+{
+    const t_spawn   *sp;
+    const char      *path;
+    char            pathbuf[PATH_MAX];
+    sigset_t        oldmask;
+    volatile int    exec_errno;
+    int             errpipe[2];
+}   t_spawn_ctx;
+
+static int g_backend = -1;
+
+static int backend_from_env(void)
+{
+    const char *env;
+
+    env = getenv("FT_POPEN_SPAWN");
+    if(!env)
+        return(FT_POPEN_SPAWN);
+    if(strcmp(env, "fork") == 0)
+        return(FT_SPAWN_FORK);
+    if(strcmp(env, "vfork") == 0)
+        return(FT_SPAWN_VFORK);
+    if(strcmp(env, "posix") == 0)
+        return(FT_SPAWN_POSIX);
+    if(strcmp(env, "clone") == 0)
+        return(FT_SPAWN_CLONE);
+    return(FT_POPEN_SPAWN);
+}
+
+int ft_popen_set_spawn(int backend)
+{
+    if(backend < FT_SPAWN_FORK || backend > FT_SPAWN_CLONE)
+        return(-1);
+    g_backend = backend;
+    return(0);
+}
+
+int ft_popen_get_spawn(void)
+{
+    if(g_backend == -1)
+        g_backend = backend_from_env();
+    return(g_backend);
+}
+
+// dup2 onto itself would keep O_CLOEXEC, so clear it by hand
+static int child_dup(int fd, int target)
+{
+    if(fd == -1)
+        return(0);
+    if(fd == target)
+        return(fcntl(fd, F_SETFD, 0));
+    return(dup2(fd, target));
+}
+
+// Tells the parent why we never reached the new program: through the
+// memory vfork/clone children share with it, or through the O_CLOEXEC
+// status pipe after a fork (a successful exec just closes that pipe).
+static void child_fail(t_spawn_ctx *ctx)
+{
+    int err;
+
+    err = errno;
+    ctx->exec_errno = err;
+    while(ctx->errpipe[1] != -1
+        && write(ctx->errpipe[1], &err, sizeof(err)) == -1 && errno == EINTR)
+        ;
+    _exit(1);
+}
+
+// Same wiring as the plain fork() child, child_fail _exits so we never
+// flush stdio buffers that belong to the parent. Our pipe ends are O_CLOEXEC
+// and close_range marks everything else past stderr the same way, so
+// the exec'd program starts with a 3-entry fd table whatever we hold.
+static void child_exec(t_spawn_ctx *ctx)
+{
+    const t_spawn *sp;
+
+    sp = ctx->sp;
+    if(child_dup(sp->in, STDIN_FILENO) == -1)
+        child_fail(ctx);
+    if(child_dup(sp->out, STDOUT_FILENO) == -1)
+        child_fail(ctx);
+    close_range(STDERR_FILENO + 1, ~0U, CLOSE_RANGE_CLOEXEC);
+    if(ctx->path)
+        execv(ctx->path, sp->argv);
+    execvp(sp->file, sp->argv);
+    child_fail(ctx);
+}
+
+// vfork/clone children share our memory: a parent handler must never
+// run on the child side, so reset them before unblocking signals
+static void child_reset_signals(const sigset_t *oldmask)
+{
+    struct sigaction sa;
+    int sig;
+
+    sig = 1;
+    while(sig < NSIG)
+    {
+        if(sigaction(sig, NULL, &sa) == 0
+            && sa.sa_handler != SIG_DFL && sa.sa_handler != SIG_IGN)
+        {
+            sa.sa_handler = SIG_DFL;
+            sa.sa_flags = 0;
+            sigemptyset(&sa.sa_mask);
+            sigaction(sig, &sa, NULL);
+        }
+        sig++;
+    }
+    sigprocmask(SIG_SETMASK, oldmask, NULL);
+}
+
+static int clone_entry(void *arg)
+{
+    t_spawn_ctx *ctx;
+
+    ctx = arg;
+    child_reset_signals(&ctx->oldmask);
+    child_exec(ctx);
+    return(1);
+}
+
+static pid_t spawn_fork(t_spawn_ctx *ctx)
+{
+    pid_t pid;
+
+    if(ctx->sp->check_exec && pipe2(ctx->errpipe, O_CLOEXEC) == -1)
+        return(-1);
+    pid = fork();
+    if(pid == 0)
+        child_exec(ctx);
+    if(ctx->errpipe[1] != -1)
+    {
+        close(ctx->errpipe[1]);
+        ctx->errpipe[1] = -1;
+    }
+    // blocks until the child execs (EOF) or reports its errno
+    if(pid > 0 && ctx->errpipe[0] != -1
+        && read(ctx->errpipe[0], (int *)&ctx->exec_errno, sizeof(int)) != sizeof(int))
+        ctx->exec_errno = 0;
+    if(ctx->errpipe[0] != -1)
+        close(ctx->errpipe[0]);
+    return(pid);
+}
+
+static pid_t spawn_vfork(t_spawn_ctx *ctx)
+{
+    pid_t pid;
+
+    pid = vfork();
+    if(pid == 0)
+    {
+        child_reset_signals(&ctx->oldmask);
+        child_exec(ctx);
+    }
+    return(pid);
+}
+
+static pid_t spawn_clone(t_spawn_ctx *ctx)
+{
+    char *stack;
+    pid_t pid;
+
+    stack = mmap(NULL, FT_SPAWN_STACK, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+    if(stack == MAP_FAILED)
+        return(-1);
+    if(ctx->sp->pidfd)
+        pid = clone(clone_entry, stack + FT_SPAWN_STACK,
+            CLONE_VM | CLONE_VFORK | CLONE_PIDFD | SIGCHLD, ctx, ctx->sp->pidfd);
+    else
+        pid = clone(clone_entry, stack + FT_SPAWN_STACK,
+            CLONE_VM | CLONE_VFORK | SIGCHLD, ctx);
+    munmap(stack, FT_SPAWN_STACK);
+    return(pid);
+}
+
+static pid_t spawn_posix(const t_spawn_ctx *ctx)
+{
+    posix_spawn_file_actions_t fa;
+    const t_spawn *sp;
+    pid_t pid;
+    int err;
+
+    sp = ctx->sp;
+    if(posix_spawn_file_actions_init(&fa) != 0)
+        return(-1);
+    err = 0;
+    if(sp->in != -1)
+        err = posix_spawn_file_actions_adddup2(&fa, sp->in, STDIN_FILENO);
+    if(!err && sp->out != -1)
+        err = posix_spawn_file_actions_adddup2(&fa, sp->out, STDOUT_FILENO);
+    if(!err)
+        err = posix_spawn_file_actions_addclosefrom_np(&fa, STDERR_FILENO + 1);
+    if(!err && ctx->path)
+        err = posix_spawn(&pid, ctx->path, &fa, NULL, sp->argv, environ);
+    else if(!err)
+        err = posix_spawnp(&pid, sp->file, &fa, NULL, sp->argv, environ);
+    // the binary moved or is a script without #!: let libc walk PATH
+    if(ctx->path && (err == ENOEXEC || err == ENOENT))
+        err = posix_spawnp(&pid, sp->file, &fa, NULL, sp->argv, environ);
+    posix_spawn_file_actions_destroy(&fa);
+    if(err)
+    {
+        errno = err;
+        return(-1);
+    }
+    return(pid);
+}
+
+// the child never made it to exec: reap it and hand its errno over
+static pid_t spawn_failed(const t_spawn *sp, pid_t pid, int err)
+{
+    if(sp->pidfd && *sp->pidfd != -1)
+        close(*sp->pidfd);
+    if(sp->pidfd)
+        *sp->pidfd = -1;
+    while(waitpid(pid, NULL, 0) == -1 && errno == EINTR)
+        ;
+    errno = err;
+    return(-1);
+}
+
+// Returns the child pid in the parent, -1 on error. The child never
+// returns: it execs or _exit(1)s like the original ft_popen child.
+// With sp->check_exec a failed exec is an error too: ft_spawn returns
+// -1 with the child's errno before the caller ever sees the pid.
+pid_t ft_spawn(int backend, const t_spawn *sp)
+{
+    t_spawn_ctx ctx;
+    sigset_t all;
+    pid_t pid;
+    int err;
+
+    ctx.sp = sp;
+    ctx.path = NULL;
+    ctx.exec_errno = 0;
+    ctx.errpipe[0] = -1;
+    ctx.errpipe[1] = -1;
+    if(ft_path_resolve(sp->file, ctx.pathbuf, sizeof(ctx.pathbuf)) == 0)
+        ctx.path = ctx.pathbuf;
+    if(sp->pidfd)
+        *sp->pidfd = -1;
+    if(backend == FT_SPAWN_FORK)
+        pid = spawn_fork(&ctx);
+    else if(backend == FT_SPAWN_POSIX)
+        pid = spawn_posix(&ctx);
+    else
+    {
+        sigfillset(&all);
+        pthread_sigmask(SIG_SETMASK, &all, &ctx.oldmask);
+        if(backend == FT_SPAWN_VFORK)
+            pid = spawn_vfork(&ctx);
+        else
+            pid = spawn_clone(&ctx);
+        err = errno;
+        pthread_sigmask(SIG_SETMASK, &ctx.oldmask, NULL);
+        errno = err;
+    }
+    // posix_spawnp reports a failed exec itself; without check_exec the
+    // caller still expects a stream whose child exits 1, so let a forked
+    // child run into the same error
+    if(pid == -1 && backend == FT_SPAWN_POSIX && !sp->check_exec)
+        pid = spawn_fork(&ctx);
+    // only clone hands out a pidfd atomically, the child is still
+    // unreaped here so pidfd_open cannot race with pid reuse
+    if(pid > 0 && sp->pidfd && *sp->pidfd == -1)
+        *sp->pidfd = ft_pidfd_open(pid);
+    if(pid > 0 && sp->check_exec && ctx.exec_errno)
+        return(spawn_failed(sp, pid, ctx.exec_errno));
+    return(pid);
+}
@@ -0,0 +1,508 @@
+#define _GNU_SOURCE
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <linux/close_range.h>
+#include "ft_popen.h"
+
+// one request per datagram: header, then file and argv as \0-separated strings
+#define FT_ZYGOTE_MSG  (64 * 1024)
+#define FT_ZYGOTE_ARGS 4096
+#define FT_ZYGOTE_SOCK 3
+
+typedef struct s_zmsg
+{
+    char    op;
+    char    type;
+    int     argc;
+    pid_t   pid;
+}   t_zmsg;
+
+// pid of the spawned/reaped child (-1 on failure), value is the wait
+// status for 'W' and the errno when pid is -1
+typedef struct s_zreply
+{
+    pid_t   pid;
+    int     value;
+}   t_zreply;
+
+// helper side: 'W' requests whose child still runs, each with the
+// socket its reply goes to
+typedef struct s_zwait
+{
+    pid_t   pid;
+    int     fd;
+}   t_zwait;
+
+typedef struct s_zwaits
+{
+    t_zwait *w;
+    size_t  n;
+    size_t  cap;
+}   t_zwaits;
+
+static int g_zsock = -1;
+static pid_t g_zpid = -1;
+static pthread_mutex_t g_zlock = PTHREAD_MUTEX_INITIALIZER;
+static int g_zchld[2] = {-1, -1};
+
+static int zygote_send(int sock, const void *buf, size_t len, int fd)
+{
+    union
+    {
+        char            buf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr  align;
+    }   ctl;
+    struct msghdr mh;
+    struct iovec iov;
+    struct cmsghdr *cm;
+
+    memset(&mh, 0, sizeof(mh));
+    iov.iov_base = (void *)buf;
+    iov.iov_len = len;
+    mh.msg_iov = &iov;
+    mh.msg_iovlen = 1;
+    if(fd != -1)
+    {
+        mh.msg_control = ctl.buf;
+        mh.msg_controllen = sizeof(ctl.buf);
+        cm = CMSG_FIRSTHDR(&mh);
+        cm->cmsg_level = SOL_SOCKET;
+        cm->cmsg_type = SCM_RIGHTS;
+        cm->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cm), &fd, sizeof(int));
+    }
+    if(sendmsg(sock, &mh, MSG_NOSIGNAL) == -1)
+        return(-1);
+    return(0);
+}
+
+static ssize_t zygote_recv(int sock, void *buf, size_t len, int *fd)
+{
+    union
+    {
+        char            buf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr  align;
+    }   ctl;
+    struct msghdr mh;
+    struct iovec iov;
+    struct cmsghdr *cm;
+    ssize_t n;
+
+    memset(&mh, 0, sizeof(mh));
+    iov.iov_base = buf;
+    iov.iov_len = len;
+    mh.msg_iov = &iov;
+    mh.msg_iovlen = 1;
+    mh.msg_control = ctl.buf;
+    mh.msg_controllen = sizeof(ctl.buf);
+    *fd = -1;
+    while((n = recvmsg(sock, &mh, MSG_CMSG_CLOEXEC)) == -1 && errno == EINTR)
+        ;
+    cm = (n > 0) ? CMSG_FIRSTHDR(&mh) : NULL;
+    if(cm && cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_RIGHTS)
+        memcpy(fd, CMSG_DATA(cm), sizeof(int));
+    return(n);
+}
+
+// helper side: unpack the strings and spawn like ft_popen would
+static void zygote_spawn(char *buf, ssize_t n, int sock)
+{
+    t_zmsg *msg;
+    t_zreply reply;
+    char *argv[FT_ZYGOTE_ARGS + 1];
+    char *p;
+    t_spawn sp;
+    int fd[2];
+    int i;
+
+    msg = (t_zmsg *)buf;
+    p = buf + sizeof(t_zmsg);
+    sp.file = p;
+    i = -1;
+    while(++i <= msg->argc && i <= FT_ZYGOTE_ARGS && p < buf + n)
+    {
+        if(i > 0)
+            argv[i - 1] = p;
+        p += strlen(p) + 1;
+    }
+    reply.pid = -1;
+    reply.value = EINVAL;
+    if(i == msg->argc + 1 && p <= buf + n && pipe2(fd, O_CLOEXEC) == 0)
+    {
+        argv[msg->argc] = NULL;
+        sp.argv = argv;
+        sp.pidfd = NULL;
+        sp.check_exec = 0;
+        sp.in = (msg->type == 'w') ? fd[0] : -1;
+        sp.out = (msg->type == 'r') ? fd[1] : -1;
+        reply.pid = ft_spawn(ft_popen_get_spawn(), &sp);
+        reply.value = errno;
+        close(msg->type == 'r' ? fd[1] : fd[0]);
+        zygote_send(sock, &reply, sizeof(reply),
+            reply.pid == -1 ? -1 : fd[msg->type == 'r' ? 0 : 1]);
+        close(msg->type == 'r' ? fd[0] : fd[1]);
+        return;
+    }
+    zygote_send(sock, &reply, sizeof(reply), -1);
+}
+
+// helper side: SIGCHLD only wakes the serve loop through a self-pipe
+static void zygote_sigchld(int sig)
+{
+    int saved;
+    ssize_t n;
+
+    (void)sig;
+    saved = errno;
+    n = write(g_zchld[1], "", 1);
+    (void)n;
+    errno = saved;
+}
+
+static int zygote_sigchld_init(void)
+{
+    struct sigaction sa;
+
+    if(pipe2(g_zchld, O_CLOEXEC | O_NONBLOCK) == -1)
+        return(-1);
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = zygote_sigchld;
+    sa.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+    sigemptyset(&sa.sa_mask);
+    return(sigaction(SIGCHLD, &sa, NULL));
+}
+
+// 1 once pid is reaped (or is not ours) and the reply went out on fd,
+// 0 while it still runs. fd -1 is a waiter nobody listens to.
+static int zygote_try_reap(pid_t pid, int fd)
+{
+    t_zreply reply;
+    pid_t r;
+
+    reply.pid = pid;
+    reply.value = 0;
+    while((r = waitpid(pid, &reply.value, WNOHANG)) == -1 && errno == EINTR)
+        ;
+    if(r == 0)
+        return(0);
+    if(r == -1)
+    {
+        reply.pid = -1;
+        reply.value = errno;
+    }
+    if(fd != -1)
+    {
+        zygote_send(fd, &reply, sizeof(reply), -1);
+        close(fd);
+    }
+    return(1);
+}
+
+static void zygote_wait_add(t_zwaits *ws, pid_t pid, int fd)
+{
+    t_zwait *tmp;
+    t_zreply reply;
+
+    if(ws->n == ws->cap)
+    {
+        tmp = realloc(ws->w, (ws->cap ? ws->cap * 2 : 16) * sizeof(t_zwait));
+        if(!tmp && fd != -1)
+        {
+            reply.pid = -1;
+            reply.value = ENOMEM;
+            zygote_send(fd, &reply, sizeof(reply), -1);
+            close(fd);
+        }
+        if(!tmp)
+            return;
+        ws->w = tmp;
+        ws->cap = ws->cap ? ws->cap * 2 : 16;
+    }
+    ws->w[ws->n].pid = pid;
+    ws->w[ws->n++].fd = fd;
+}
+
+// after a SIGCHLD: answer every waiter whose child is gone
+static void zygote_wait_scan(t_zwaits *ws)
+{
+    char drain[64];
+    size_t i;
+
+    while(read(g_zchld[0], drain, sizeof(drain)) > 0)
+        ;
+    i = 0;
+    while(i < ws->n)
+    {
+        if(zygote_try_reap(ws->w[i].pid, ws->w[i].fd))
+            ws->w[i] = ws->w[--ws->n];
+        else
+            i++;
+    }
+}
+
+// anything shorter than a header is dropped; a 'W' without a reply
+// socket still reaps its child, the answer just goes nowhere
+static void zygote_wait_req(const t_zmsg *msg, ssize_t n, int fd,
+    t_zwaits *ws)
+{
+    if(n < (ssize_t)sizeof(t_zmsg) || msg->op != 'W')
+    {
+        if(fd != -1)
+            close(fd);
+        return;
+    }
+    if(!zygote_try_reap(msg->pid, fd))
+        zygote_wait_add(ws, msg->pid, fd);
+}
+
+// Spawns are answered in order on the shared socket. A 'W' brings its
+// own reply socket: a child that has already exited is answered at once,
+// one that still runs waits in ws until its SIGCHLD, so a long-running
+// child never holds up the spawns and reaps of everyone else.
+static void zygote_serve(int sock)
+{
+    char buf[FT_ZYGOTE_MSG + 1];
+    struct pollfd pfd[2];
+    t_zwaits ws;
+    ssize_t n;
+    int fd;
+
+    memset(&ws, 0, sizeof(ws));
+    if(zygote_sigchld_init() == -1)
+        _exit(1);
+    pfd[0].fd = sock;
+    pfd[0].events = POLLIN;
+    pfd[1].fd = g_zchld[0];
+    pfd[1].events = POLLIN;
+    while(1)
+    {
+        if(poll(pfd, 2, -1) == -1)
+        {
+            if(errno == EINTR)
+                continue;
+            break;
+        }
+        if(pfd[1].revents & POLLIN)
+            zygote_wait_scan(&ws);
+        if(!(pfd[0].revents & (POLLIN | POLLHUP | POLLERR)))
+            continue;
+        n = zygote_recv(sock, buf, FT_ZYGOTE_MSG, &fd);
+        if(n <= 0)
+            break;
+        if(n < (ssize_t)sizeof(t_zmsg) || ((t_zmsg *)buf)->op != 'S')
+        {
+            zygote_wait_req((t_zmsg *)buf, n, fd, &ws);
+            continue;
+        }
+        if(fd != -1)
+            close(fd);
+        buf[n] = '\0';
+        zygote_spawn(buf, n + 1, sock);
+    }
+    _exit(0);
+}
+
+int ft_zygote_start(void)
+{
+    int sv[2];
+    pid_t pid;
+
+    pthread_mutex_lock(&g_zlock);
+    if(g_zsock != -1)
+    {
+        pthread_mutex_unlock(&g_zlock);
+        return(0);
+    }
+    if(socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) == -1)
+    {
+        pthread_mutex_unlock(&g_zlock);
+        return(-1);
+    }
+    pid = fork();
+    if(pid == 0)
+    {
+        if(dup2(sv[1], FT_ZYGOTE_SOCK) == -1)
+            _exit(1);
+        close_range(FT_ZYGOTE_SOCK + 1, ~0U, 0);
+        zygote_serve(FT_ZYGOTE_SOCK);
+    }
+    close(sv[1]);
+    if(pid == -1)
+        close(sv[0]);
+    else
+    {
+        g_zsock = sv[0];
+        g_zpid = pid;
+    }
+    pthread_mutex_unlock(&g_zlock);
+    return(pid == -1 ? -1 : 0);
+}
+
+// what came back from the helper: a short read means it is gone
+static int zygote_reply(ssize_t n, t_zreply *reply, int *fd)
+{
+    if(n != (ssize_t)sizeof(*reply))
+    {
+        if(n >= 0)
+            errno = ECHILD;
+        if(*fd != -1)
+            close(*fd);
+        return(-1);
+    }
+    if(reply->pid == -1)
+    {
+        errno = reply->value;
+        return(-1);
+    }
+    return(0);
+}
+
+// one spawn round trip with the helper, serialized between threads
+static int zygote_call(const void *msg, size_t len, t_zreply *reply, int *fd)
+{
+    ssize_t n;
+
+    pthread_mutex_lock(&g_zlock);
+    n = -1;
+    if(g_zsock == -1)
+        errno = ECHILD;
+    else if(zygote_send(g_zsock, msg, len, -1) == 0)
+        n = zygote_recv(g_zsock, reply, sizeof(*reply), fd);
+    pthread_mutex_unlock(&g_zlock);
+    return(zygote_reply(n, reply, fd));
+}
+
+// The request carries one end of a private socketpair and the status
+// comes back on the other, so the lock is only held for the send: waiting
+// on a long-running child blocks nobody else.
+static int zygote_reap(pid_t pid, int *status)
+{
+    t_zmsg msg;
+    t_zreply reply;
+    int sv[2];
+    ssize_t n;
+    int fd;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.op = 'W';
+    msg.pid = pid;
+    fd = -1;
+    if(socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) == -1)
+        return(-1);
+    pthread_mutex_lock(&g_zlock);
+    n = -1;
+    if(g_zsock == -1)
+        errno = ECHILD;
+    else
+        n = zygote_send(g_zsock, &msg, sizeof(msg), sv[1]);
+    pthread_mutex_unlock(&g_zlock);
+    close(sv[1]);
+    if(n == 0)
+        n = zygote_recv(sv[0], &reply, sizeof(reply), &fd);
+    close(sv[0]);
+    if(zygote_reply(n, &reply, &fd) == -1)
+        return(-1);
+    *status = reply.value;
+    return(0);
+}
+
+// the child will never be ft_pclose()d: the helper reaps it on its own.
+// Needs no fd on our side, so it works at RLIMIT_NOFILE too.
+static void zygote_discard(pid_t pid)
+{
+    t_zmsg msg;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.op = 'W';
+    msg.pid = pid;
+    pthread_mutex_lock(&g_zlock);
+    if(g_zsock != -1)
+        zygote_send(g_zsock, &msg, sizeof(msg), -1);
+    pthread_mutex_unlock(&g_zlock);
+}
+
+static size_t zygote_pack(char *buf, const char *file, char *const argv[])
+{
+    t_zmsg *msg;
+    size_t len;
+    size_t n;
+
+    msg = (t_zmsg *)buf;
+    len = sizeof(t_zmsg);
+    n = strlen(file) + 1;
+    if(len + n > FT_ZYGOTE_MSG)
+        return(0);
+    memcpy(buf + len, file, n);
+    len += n;
+    while(argv[msg->argc])
+    {
+        n = strlen(argv[msg->argc]) + 1;
+        if(len + n > FT_ZYGOTE_MSG || msg->argc == FT_ZYGOTE_ARGS)
+            return(0);
+        memcpy(buf + len, argv[msg->argc], n);
+        len += n;
+        msg->argc++;
+    }
+    return(len);
+}
+
+int ft_zygote_popen(const char *file, char *const argv[], char type)
+{
+    char *buf;
+    t_zreply reply;
+    size_t len;
+    int fd;
+
+    if(!file || !argv || (type != 'r' && type != 'w'))
+        return(-1);
+    if(ft_zygote_start() == -1)
+        return(-1);
+    buf = calloc(1, FT_ZYGOTE_MSG);
+    if(!buf)
+        return(-1);
+    ((t_zmsg *)buf)->op = 'S';
+    ((t_zmsg *)buf)->type = type;
+    len = zygote_pack(buf, file, argv);
+    fd = -1;
+    if(len == 0)
+        errno = E2BIG;
+    if(len == 0 || zygote_call(buf, len, &reply, &fd) == -1)
+    {
+        free(buf);
+        return(-1);
+    }
+    free(buf);
+    // the child runs but its pipe end was dropped on the way (MSG_CTRUNC,
+    // we are at RLIMIT_NOFILE): nobody could ever reach it, kill it
+    if(fd == -1)
+    {
+        kill(reply.pid, SIGKILL);
+        zygote_discard(reply.pid);
+        errno = EMFILE;
+        return(-1);
+    }
+    return(ft_popen_register_with(fd, reply.pid, zygote_reap));
+}
+
+void ft_zygote_stop(void)
+{
+    pthread_mutex_lock(&g_zlock);
+    if(g_zsock != -1)
+    {
+        close(g_zsock);
+        while(waitpid(g_zpid, NULL, 0) == -1 && errno == EINTR)
+            ;
+        g_zsock = -1;
+        g_zpid = -1;
+    }
+    pthread_mutex_unlock(&g_zlock);
+}
@@ -2,10 +2,11 @@
 source ../../../main/colors.sh
 
 file1=ft_popen.c
+srcs1="ft_popen.c ft_spawn.c ft_pipe_size.c ../common/ft_pathcache.c ../common/ft_pidfd.c"
 file2=../../../../rendu/ft_popen/ft_popen.c
 
 # Test 1
-gcc -Werror -Wall -Wextra -o out1 main.c ft_popen.c
+gcc -Werror -Wall -Wextra -o out1 main.c $srcs1
 gcc -Werror -Wall -Wextra -o out2 main.c ../../../../rendu/ft_popen/ft_popen.c
 
 ./out1 "test command 1" > out1.txt 2>/dev/null
@@ -0,0 +1,66 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include "../picoshell.h"
+
+// Short pipelines per second with builtin stages off (fork + exec for
+// every stage) and on (cat/head/wc/grep -F run as threads).
+// Build: gcc -O2 -pthread -o bench_builtins bench/bench_builtins.c picoshell.c picoshell_builtins.c ../common/ft_pathcache.c
+// Usage: ./bench_builtins [iterations]   (default: 500)
+
+static double now_s(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec + ts.tv_nsec / 1e9);
+}
+
+static double pipelines_per_s(char **cmds[], int iterations, int builtins)
+{
+    double t0;
+
+    picoshell_set_builtins(builtins);
+    t0 = now_s();
+    for (int i = 0; i < iterations; i++)
+        picoshell(cmds);
+    return (iterations / (now_s() - t0));
+}
+
+int main(int argc, char **argv)
+{
+    int iterations = argc > 1 ? atoi(argv[1]) : 500;
+    char *echo[] = {"echo", "hello", NULL};
+    char *seq[] = {"seq", "1", "1000", NULL};
+    char *cat[] = {"cat", NULL};
+    char *head[] = {"head", "-n", "5", NULL};
+    char *grep[] = {"grep", "-F", "99", NULL};
+    char *wc[] = {"wc", "-l", NULL};
+    char **p1[] = {echo, cat, NULL};
+    char **p2[] = {seq, head, NULL};
+    char **p3[] = {seq, grep, wc, NULL};
+    char **p4[] = {seq, cat, grep, head, wc, NULL};
+    char ***pipes[] = {p1, p2, p3, p4};
+    const char *names[] = {"echo | cat", "seq | head -n 5", "seq | grep -F | wc -l",
+        "seq | cat | grep -F | head | wc -l"};
+    int null_fd = open("/dev/null", O_WRONLY);
+    int saved = dup(STDOUT_FILENO);
+
+    if (null_fd == -1 || saved == -1)
+        return (1);
+    dprintf(saved, "%-36s %12s %12s   (pipelines/s, %d iterations)\n",
+        "pipeline", "exec", "builtins", iterations);
+    for (int i = 0; i < 4; i++) {
+        double off, on;
+
+        dup2(null_fd, STDOUT_FILENO);
+        off = pipelines_per_s(pipes[i], iterations, 0);
+        on = pipelines_per_s(pipes[i], iterations, 1);
+        dup2(saved, STDOUT_FILENO);
+        printf("%-36s %12.1f %12.1f\n", names[i], off, on);
+        fflush(stdout);
+    }
+    return (0);
+}
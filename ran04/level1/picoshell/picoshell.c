@@ -1,68 +1,313 @@
+#define _GNU_SOURCE
 #include <unistd.h>
 #include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <string.h>
+#include <stdio.h>
+#include <signal.h>
+#include <pthread.h>
 #include <sys/wait.h>
+#include <sys/resource.h>
+#include "picoshell.h"
+#include "../common/ft_pathcache.h"
 
-int picoshell(char **cmds[])
+static void	fill_report(t_stage_report *r, pid_t pid, int status,
+		const struct rusage *ru)
 {
-	int		i;
-	int		pipefd[2];
-	int		prev_fd;
-	int		status;
-	int		exit_code;
-	pid_t	pid;
-	
-	i			= 0;
-	exit_code	= 0;
-	prev_fd		= -1;
-	while (cmds[i])
+	r->pid = pid;
+	r->status = status;
+	r->exit_code = -1;
+	r->term_signal = -1;
+	if (status != -1 && WIFEXITED(status))
 	{
-		if (cmds[i + 1] && pipe(pipefd))
-			return (1);
-		pid = fork();
-		if (pid == -1)
-		{
-			if (cmds[i + 1])
-			{
-				close(pipefd[0]);
-				close(pipefd[1]);
-			}
-			if (prev_fd != -1)
-				close(prev_fd);
-			return (1);
-		}
-		if (pid == 0)
-		{
-			if (prev_fd != -1)
-			{
-				if (dup2(prev_fd, STDIN_FILENO) == -1)
-					exit(1);
-				close(prev_fd);
-			}
-			if (cmds[i + 1])
-			{
-				close(pipefd[0]);
-				if (dup2(pipefd[1], STDOUT_FILENO) == -1)
-					exit(1);
-				close(pipefd[1]);
-			}
-			execvp(cmds[i][0], cmds[i]);
-			exit(1);
-		}
-		if (prev_fd != -1)
-			close(prev_fd);
-		if (cmds[i + 1])
-		{
-			close(pipefd[1]);
-			prev_fd = pipefd[0];
-		}
-		i++;
+		r->exit_code = WEXITSTATUS(status);
+		r->term_signal = 0;
 	}
-	while(wait(&status) != -1)
+	else if (status != -1 && WIFSIGNALED(status))
+		r->term_signal = WTERMSIG(status);
+	r->utime_us = ru->ru_utime.tv_sec * 1000000L + ru->ru_utime.tv_usec;
+	r->stime_us = ru->ru_stime.tv_sec * 1000000L + ru->ru_stime.tv_usec;
+	r->maxrss_kb = ru->ru_maxrss;
+	r->minflt = ru->ru_minflt;
+	r->majflt = ru->ru_majflt;
+	r->nvcsw = ru->ru_nvcsw;
+	r->nivcsw = ru->ru_nivcsw;
+}
+
+// One stage: a forked child (pid > 0) or a builtin thread (pid 0).
+// A builtin thread owns in/out and closes them when it is done, unless
+// they are our own stdin/stdout.
+typedef struct s_stage
+{
+	pid_t			pid;
+	t_builtin		builtin;
+	char			**argv;
+	int				in;
+	int				out;
+	int				status;
+	struct rusage	ru;
+	pthread_t		thread;
+}	t_stage;
+
+// SIGPIPE stays blocked in the thread: a write to a gone reader fails
+// with EPIPE instead of killing the process, and is then reported the
+// way the real command would have died
+static void	*builtin_main(void *arg)
+{
+	static const struct timespec	now = {0, 0};
+	t_stage							*st;
+	sigset_t						pipe_set;
+	int								ret;
+
+	st = arg;
+	sigemptyset(&pipe_set);
+	sigaddset(&pipe_set, SIGPIPE);
+	pthread_sigmask(SIG_BLOCK, &pipe_set, NULL);
+	ret = st->builtin.run(st->argv, st->in, st->out);
+	if (st->in != STDIN_FILENO)
+		close(st->in);
+	if (st->out != STDOUT_FILENO)
+		close(st->out);
+	if (ret == PICOSHELL_EPIPE)
+		sigtimedwait(&pipe_set, NULL, &now);
+	st->status = (ret == PICOSHELL_EPIPE) ? SIGPIPE : (ret & 0xff) << 8;
+	getrusage(RUSAGE_THREAD, &st->ru);
+	return (NULL);
+}
+
+static int	wait_stage(t_stage *st, struct rusage *ru)
+{
+	int	status;
+
+	if (st->pid == 0)
 	{
-		if (WIFEXITED(status) && WEXITSTATUS(status) != 0)
-			exit_code = 1;
-		else if (!WIFEXITED(status))
+		pthread_join(st->thread, NULL);
+		*ru = st->ru;
+		return (st->status);
+	}
+	memset(ru, 0, sizeof(*ru));
+	while (wait4(st->pid, &status, 0, ru) == -1)
+	{
+		if (errno != EINTR)
+			return (-1);
+	}
+	return (status);
+}
+
+// Only the stages this call started are waited for, one wait4() or
+// pthread_join() each, so pipelines running in other threads keep their
+// own statuses. The pipes are O_CLOEXEC: a child forked by another
+// pipeline in the meantime must not hold our write ends open, or our
+// reader would never see EOF.
+static int	wait_stages(t_stage *stages, int n, t_stage_report *reports)
+{
+	struct rusage	ru;
+	int				status;
+	int				exit_code;
+	int				i;
+
+	exit_code = 0;
+	i = 0;
+	while (i < n)
+	{
+		status = wait_stage(&stages[i], &ru);
+		if (status == -1 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
 			exit_code = 1;
+		if (reports)
+			fill_report(&reports[i], stages[i].pid, status, &ru);
+		i++;
 	}
 	return (exit_code);
 }
+
+// path is cmd[0] resolved in the parent (the PATH cache takes a lock, a
+// forked child of a threaded process must not), NULL if it was not
+static void	child_exec(char **cmd, const char *path, int prev_fd,
+		int pipefd[2])
+{
+	if (prev_fd != -1 && dup2(prev_fd, STDIN_FILENO) == -1)
+		_exit(1);
+	if (pipefd && dup2(pipefd[1], STDOUT_FILENO) == -1)
+		_exit(1);
+	if (path)
+		execv(path, cmd);
+	execvp(cmd[0], cmd);
+	_exit(1);
+}
+
+// builtin thread if cmd names one (and the thread starts), else fork+exec
+static int	start_stage(t_stage *st, char **cmd, int prev_fd, int *pipefd)
+{
+	char	path[PATH_MAX];
+	int		resolved;
+
+	st->argv = cmd;
+	st->in = (prev_fd != -1) ? prev_fd : STDIN_FILENO;
+	st->out = pipefd ? pipefd[1] : STDOUT_FILENO;
+	st->pid = 0;
+	if (picoshell_find_builtin(cmd, &st->builtin)
+		&& pthread_create(&st->thread, NULL, builtin_main, st) == 0)
+		return (0);
+	resolved = (ft_path_resolve(cmd[0], path, sizeof(path)) == 0);
+	st->pid = fork();
+	if (st->pid == 0)
+		child_exec(cmd, resolved ? path : NULL, prev_fd, pipefd);
+	if (prev_fd != -1)
+		close(prev_fd);
+	if (pipefd)
+		close(pipefd[1]);
+	return (st->pid == -1 ? -1 : 0);
+}
+
+static int	spawn_failed(t_stage *stages, int started, int prev_fd,
+		t_stage_report *reports)
+{
+	if (prev_fd != -1)
+		close(prev_fd);
+	wait_stages(stages, started, reports);
+	free(stages);
+	return (1);
+}
+
+// every stage starts as "never ran", wait_stages() fills the real ones
+static void	init_reports(t_stage_report *reports, int n)
+{
+	struct rusage	none;
+	int				i;
+
+	memset(&none, 0, sizeof(none));
+	i = 0;
+	while (reports && i < n)
+		fill_report(&reports[i++], -1, -1, &none);
+}
+
+static int	redir_error(const char *path, int io[2])
+{
+	dprintf(STDERR_FILENO, "picoshell: %s: %s\n", path, strerror(errno));
+	if (io[0] != -1)
+		close(io[0]);
+	io[0] = -1;
+	return (-1);
+}
+
+// Both files are opened before anything runs, so a missing input or an
+// unwritable output fails the pipeline with 1 and nothing started. They
+// are O_CLOEXEC and handed to the first/last stage like a pipe end: a
+// child dup2()s it, a builtin thread uses it as is.
+static int	open_redirs(const t_redirs *r, int io[2])
+{
+	int	mode;
+
+	io[0] = -1;
+	io[1] = -1;
+	if (!r)
+		return (0);
+	if (r->in)
+		io[0] = open(r->in, O_RDONLY | O_CLOEXEC);
+	if (r->in && io[0] == -1)
+		return (redir_error(r->in, io));
+	mode = r->append ? O_APPEND : O_TRUNC;
+	if (r->out)
+		io[1] = open(r->out, O_WRONLY | O_CREAT | O_CLOEXEC | mode, 0666);
+	if (r->out && io[1] == -1)
+		return (redir_error(r->out, io));
+	if ((r->flags & PICOSHELL_BIGIO) && io[0] != -1)
+	{
+		posix_fadvise(io[0], 0, 0, POSIX_FADV_SEQUENTIAL);
+		posix_fadvise(io[0], 0, 0, POSIX_FADV_NOREUSE);
+	}
+	if ((r->flags & PICOSHELL_BIGIO) && io[1] != -1)
+		posix_fadvise(io[1], 0, 0, POSIX_FADV_NOREUSE);
+	return (0);
+}
+
+// a pipe between two stages, grown to PICOSHELL_BIGIO_PIPE if asked to
+// (best effort, past pipe-user-pages-soft the kernel keeps the default)
+static int	open_pipe(int pipefd[2], const t_redirs *r)
+{
+	if (pipe2(pipefd, O_CLOEXEC) == -1)
+		return (-1);
+	if (r && (r->flags & PICOSHELL_BIGIO))
+		fcntl(pipefd[1], F_SETPIPE_SZ, PICOSHELL_BIGIO_PIPE);
+	return (0);
+}
+
+int	picoshell(char **cmds[])
+{
+	return (picoshell_ex(cmds, NULL));
+}
+
+int	picoshell_ex(char **cmds[], t_stage_report *reports)
+{
+	return (picoshell_redir(cmds, NULL, reports));
+}
+
+// the output file is only handed out with the last stage: if we stop
+// before it, it is still ours to close
+static void	close_io(int io[2])
+{
+	if (io[0] != -1)
+		close(io[0]);
+	if (io[1] != -1)
+		close(io[1]);
+}
+
+static int	redir_failed(t_stage *stages, int started, int fds[2],
+		t_stage_report *reports)
+{
+	if (fds[1] != -1)
+		close(fds[1]);
+	return (spawn_failed(stages, started, fds[0], reports));
+}
+
+int	picoshell_redir(char **cmds[], const t_redirs *redir,
+		t_stage_report *reports)
+{
+	int		i;
+	int		n;
+	int		pipefd[2];
+	int		io[2];
+	t_stage	*stages;
+
+	n = 0;
+	while (cmds[n])
+		n++;
+	init_reports(reports, n);
+	if (open_redirs(redir, io) == -1)
+		return (1);
+	// no command still returns 0, only the files it opened are dropped
+	if (n == 0)
+	{
+		close_io(io);
+		return (0);
+	}
+	stages = malloc(n * sizeof(t_stage));
+	if (!stages)
+	{
+		close_io(io);
+		return (1);
+	}
+	// io[0] is what the next stage reads, io[1] the output file until
+	// the last stage takes it in place of a pipe
+	i = 0;
+	while (i < n)
+	{
+		if (cmds[i + 1] && open_pipe(pipefd, redir) == -1)
+			return (redir_failed(stages, i, io, reports));
+		pipefd[0] = cmds[i + 1] ? pipefd[0] : -1;
+		pipefd[1] = cmds[i + 1] ? pipefd[1] : io[1];
+		if (!cmds[i + 1])
+			io[1] = -1;
+		if (start_stage(&stages[i], cmds[i], io[0],
+				pipefd[1] != -1 ? pipefd : NULL) == -1)
+			return (redir_failed(stages, i, (int [2]){pipefd[0], io[1]},
+				reports));
+		io[0] = pipefd[0];
+		i++;
+	}
+	n = wait_stages(stages, n, reports);
+	free(stages);
+	return (n);
+}
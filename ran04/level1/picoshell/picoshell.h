@@ -0,0 +1,106 @@
+#ifndef PICOSHELL_H
+# define PICOSHELL_H
+
+# include <sys/types.h>
+
+// What one stage of the pipeline did, filled from its wait4() status and
+// rusage. exit_code is -1 when the stage was killed, term_signal is 0
+// when it exited; a stage that could not be forked has pid -1 and both
+// at -1. A builtin stage has pid 0 and its thread's rusage (maxrss is
+// then the whole process's). Times are in microseconds, maxrss_kb in KiB
+// as the kernel reports it. The slow stage is the one with the most CPU,
+// or with many voluntary switches when it mostly waits on its neighbours.
+typedef struct s_stage_report
+{
+	pid_t	pid;
+	int		status;
+	int		exit_code;
+	int		term_signal;
+	long	utime_us;
+	long	stime_us;
+	long	maxrss_kb;
+	long	minflt;
+	long	majflt;
+	long	nvcsw;
+	long	nivcsw;
+}	t_stage_report;
+
+// Builtin stages: when cmds[i][0] is a bare name (no '/') in this table
+// and accepts(argv) says it can reproduce that exact command, the stage
+// runs as a thread of ours on the same pipe fds instead of fork + exec.
+// cat, head -n, wc and grep -F are registered by default. run() returns
+// the exit code, or PICOSHELL_EPIPE when the next stage stopped reading
+// (the stage is then reported as killed by SIGPIPE, like the command).
+# define PICOSHELL_MAX_BUILTINS 32
+# define PICOSHELL_EPIPE        (-1)
+
+typedef struct s_builtin
+{
+	const char	*name;
+	int			(*accepts)(char **argv);
+	int			(*run)(char **argv, int in, int out);
+}	t_builtin;
+
+int	picoshell(char **cmds[]);
+
+// Same pipeline and result as picoshell(), reports (NULL or one entry
+// per command) gets each stage's status and resource usage.
+int	picoshell_ex(char **cmds[], t_stage_report *reports);
+
+// Redirections of the whole pipeline: in (< file) feeds the first stage,
+// out (> file, or >> file when append is set) takes the last one's
+// output. NULL leaves stdin/stdout. Both are opened by picoshell before
+// any stage starts; if one fails it prints "picoshell: file: error" and
+// returns 1 without running anything. PICOSHELL_BIGIO in flags is for
+// multi-GB files: both get posix_fadvise() SEQUENTIAL/NOREUSE so the
+// stream does not evict the page cache, and the pipes between stages are
+// grown to PICOSHELL_BIGIO_PIPE bytes.
+# define PICOSHELL_BIGIO      1
+# ifndef PICOSHELL_BIGIO_PIPE
+#  define PICOSHELL_BIGIO_PIPE (1024 * 1024)
+# endif
+
+typedef struct s_redirs
+{
+	const char	*in;
+	const char	*out;
+	int			append;
+	int			flags;
+}	t_redirs;
+
+int	picoshell_redir(char **cmds[], const t_redirs *redir,
+		t_stage_report *reports);
+
+// A command line compiled into picoshell's cmds: "ls -l | grep foo"
+// gives {{"ls", "-l", NULL}, {"grep", "foo", NULL}, NULL}. Words are split
+// on blanks and unquoted '|', with sh-style '...', "..." and \ quoting.
+// Unquoted "< file" in the first stage and "> file" or ">> file" in the
+// last one go to redir instead of argv (the last of each kind wins).
+// An fd-prefixed redirection such as "2>/dev/null" is rejected.
+// The whole thing is one allocation, released by picoshell_free(), and
+// can be run any number of times. picoshell_run() keeps the last
+// PICOSHELL_CACHE_SLOTS lines it parsed, so a repeated line is not
+// parsed again.
+# ifndef PICOSHELL_CACHE_SLOTS
+#  define PICOSHELL_CACHE_SLOTS 64
+# endif
+
+typedef struct s_pipeline
+{
+	char		***cmds;
+	int			ncmds;
+	const char	*line;
+	t_redirs	redir;
+	int			refs;
+}	t_pipeline;
+
+t_pipeline	*picoshell_parse(const char *line);
+void		picoshell_free(t_pipeline *p);
+int			picoshell_run(const char *line, t_stage_report *reports);
+void		picoshell_cache_flush(void);
+
+int	picoshell_register_builtin(const t_builtin *b);
+int	picoshell_find_builtin(char **argv, t_builtin *out);
+void	picoshell_set_builtins(int enabled);
+
+#endif
@@ -0,0 +1,481 @@
+#define _GNU_SOURCE
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <stdio.h>
+#include "picoshell.h"
+
+#define BUILTIN_BUF (64 * 1024)
+
+// Each builtin only claims the argv shapes it reproduces byte for byte
+// (GNU coreutils output, C locale); anything else is exec'd as before.
+// run() returns the exit code, or PICOSHELL_EPIPE once the reader is gone.
+
+static int	write_all(int fd, const char *buf, size_t len)
+{
+	ssize_t	n;
+
+	while (len > 0)
+	{
+		n = write(fd, buf, len);
+		if (n == -1 && errno == EINTR)
+			continue ;
+		if (n == -1)
+			return (errno == EPIPE ? PICOSHELL_EPIPE : 1);
+		buf += n;
+		len -= n;
+	}
+	return (0);
+}
+
+static ssize_t	read_some(int fd, char *buf, size_t len)
+{
+	ssize_t	n;
+
+	while ((n = read(fd, buf, len)) == -1 && errno == EINTR)
+		;
+	return (n);
+}
+
+// a read error is reported and cat goes on with the next file, a write
+// error ends it: quietly on EPIPE (the real cat dies of SIGPIPE there),
+// with GNU's message otherwise
+#define CAT_WRITE_ERROR 2
+
+static int	cat_copy(int in, int out, char *buf, const char *name)
+{
+	ssize_t	n;
+	int		ret;
+
+	while ((n = read_some(in, buf, BUILTIN_BUF)) > 0)
+	{
+		ret = write_all(out, buf, n);
+		if (ret == PICOSHELL_EPIPE)
+			return (ret);
+		if (ret)
+		{
+			dprintf(STDERR_FILENO, "cat: write error: %s\n", strerror(errno));
+			return (CAT_WRITE_ERROR);
+		}
+	}
+	if (n == -1)
+		dprintf(STDERR_FILENO, "cat: %s: %s\n", name, strerror(errno));
+	return (n == -1);
+}
+
+// cat [file|-]...
+static int	cat_accepts(char **argv)
+{
+	int	i;
+
+	i = 0;
+	while (argv[++i])
+	{
+		if (argv[i][0] == '-' && argv[i][1])
+			return (0);
+	}
+	return (1);
+}
+
+static int	cat_run(char **argv, int in, int out)
+{
+	char	*buf;
+	int		ret;
+	int		err;
+	int		fd;
+	int		i;
+
+	buf = malloc(BUILTIN_BUF);
+	if (!buf)
+		return (1);
+	ret = argv[1] ? 0 : cat_copy(in, out, buf, "-");
+	i = 0;
+	while (argv[++i] && ret != PICOSHELL_EPIPE && ret != CAT_WRITE_ERROR)
+	{
+		fd = strcmp(argv[i], "-") ? open(argv[i], O_RDONLY | O_CLOEXEC) : in;
+		if (fd == -1)
+		{
+			dprintf(STDERR_FILENO, "cat: %s: %s\n", argv[i], strerror(errno));
+			ret = 1;
+			continue ;
+		}
+		err = cat_copy(fd, out, buf, argv[i]);
+		if (err)
+			ret = err;
+		if (fd != in)
+			close(fd);
+	}
+	free(buf);
+	return (ret == CAT_WRITE_ERROR ? 1 : ret);
+}
+
+// head [-n N | -nN | -N], stdin only
+static long	head_lines(char **argv)
+{
+	const char	*s;
+	char		*end;
+	long		n;
+
+	if (!argv[1])
+		return (10);
+	s = NULL;
+	if (strcmp(argv[1], "-n") == 0 && argv[2] && !argv[3])
+		s = argv[2];
+	else if (strncmp(argv[1], "-n", 2) == 0 && argv[1][2] && !argv[2])
+		s = argv[1] + 2;
+	else if (argv[1][0] == '-' && isdigit((unsigned char)argv[1][1]) && !argv[2])
+		s = argv[1] + 1;
+	if (!s || !isdigit((unsigned char)*s))
+		return (-1);
+	n = strtol(s, &end, 10);
+	return (*end || n < 0 ? -1 : n);
+}
+
+static int	head_accepts(char **argv)
+{
+	return (head_lines(argv) >= 0);
+}
+
+static int	head_run(char **argv, int in, int out)
+{
+	char	*buf;
+	char	*nl;
+	long	left;
+	ssize_t	n;
+	int		ret;
+
+	left = head_lines(argv);
+	buf = malloc(BUILTIN_BUF);
+	if (!buf)
+		return (1);
+	ret = 0;
+	n = 0;
+	while (left > 0 && ret == 0 && (n = read_some(in, buf, BUILTIN_BUF)) > 0)
+	{
+		nl = buf;
+		while (left > 0 && (nl = memchr(nl, '\n', buf + n - nl)) != NULL)
+		{
+			nl++;
+			left--;
+		}
+		ret = write_all(out, buf, left > 0 ? (size_t)n : (size_t)(nl - buf));
+	}
+	free(buf);
+	if (ret == 0 && n == -1)
+	{
+		dprintf(STDERR_FILENO, "head: error reading 'standard input': %s\n",
+			strerror(errno));
+		ret = 1;
+	}
+	return (ret);
+}
+
+// wc [-l|-w|-c]..., stdin only
+static int	wc_flags(char **argv)
+{
+	int	flags;
+	int	i;
+	int	j;
+
+	flags = 0;
+	i = 0;
+	while (argv[++i])
+	{
+		if (argv[i][0] != '-' || !argv[i][1])
+			return (-1);
+		j = 0;
+		while (argv[i][++j])
+		{
+			if (!strchr("lwc", argv[i][j]))
+				return (-1);
+			flags |= (argv[i][j] == 'l') | (argv[i][j] == 'w') << 1
+				| (argv[i][j] == 'c') << 2;
+		}
+	}
+	return (flags ? flags : 7);
+}
+
+static int	wc_accepts(char **argv)
+{
+	return (wc_flags(argv) > 0);
+}
+
+// GNU sizes the columns from fstat: as many digits as a regular file's
+// size, 7 for a pipe or anything else, 1 when a single count is printed
+static int	wc_width(int in, int flags)
+{
+	struct stat	st;
+	off_t		size;
+	int			width;
+
+	if (flags == 1 || flags == 2 || flags == 4 || fstat(in, &st) == -1)
+		return (1);
+	if (!S_ISREG(st.st_mode))
+		return (7);
+	width = 1;
+	size = st.st_size;
+	while (size >= 10)
+	{
+		size /= 10;
+		width++;
+	}
+	return (width);
+}
+
+static int	wc_print(int out, int width, int flags,
+		const unsigned long counts[3])
+{
+	char	line[128];
+	int		len;
+	int		i;
+
+	len = 0;
+	i = -1;
+	while (++i < 3)
+	{
+		if (flags & (1 << i))
+			len += snprintf(line + len, sizeof(line) - len, "%s%*lu",
+					len ? " " : "", width, counts[i]);
+	}
+	line[len++] = '\n';
+	return (write_all(out, line, len));
+}
+
+static int	wc_done(int in, int out, char **argv,
+		const unsigned long counts[3])
+{
+	int	flags;
+
+	flags = wc_flags(argv);
+	return (wc_print(out, wc_width(in, flags), flags, counts));
+}
+
+// like GNU wc, a read error still prints the counts so far, then exits
+// 1; in the C locale only a printable byte can start a word, the other
+// non-blank ones are part of whatever word they sit in
+static int	wc_run(char **argv, int in, int out)
+{
+	unsigned long	counts[3];
+	char			*buf;
+	ssize_t			n;
+	ssize_t			i;
+	int				inword;
+
+	buf = malloc(BUILTIN_BUF);
+	if (!buf)
+		return (1);
+	memset(counts, 0, sizeof(counts));
+	inword = 0;
+	while ((n = read_some(in, buf, BUILTIN_BUF)) > 0)
+	{
+		counts[2] += n;
+		i = -1;
+		while (++i < n)
+		{
+			counts[0] += (buf[i] == '\n');
+			if (isspace((unsigned char)buf[i]))
+				inword = 0;
+			else if (isprint((unsigned char)buf[i]) && !inword++)
+				counts[1]++;
+		}
+	}
+	free(buf);
+	if (n == -1)
+		dprintf(STDERR_FILENO, "wc: 'standard input': %s\n", strerror(errno));
+	i = wc_done(in, out, argv, counts);
+	if (i)
+		return (i);
+	return (n == -1);
+}
+
+// grep -F [-v] PATTERN, stdin only; 0 if a line was selected, 1 if not.
+// Input with NUL bytes is matched as text (grep -a), GNU grep would
+// only print "binary file matches" for it. A PATTERN holding '\n' is a
+// list of patterns to grep, left to the real one.
+static int	grep_accepts(char **argv)
+{
+	int	i;
+
+	i = 1;
+	if (!argv[i] || (strcmp(argv[i], "-F") && strcmp(argv[i], "-Fv")))
+		return (0);
+	if (strcmp(argv[i], "-F") == 0 && argv[i + 1] && !strcmp(argv[i + 1], "-v"))
+		i++;
+	return (argv[i + 1] && argv[i + 1][0] != '-' && !argv[i + 2]
+		&& !strchr(argv[i + 1], '\n'));
+}
+
+typedef struct s_grep
+{
+	const char	*pat;
+	size_t		plen;
+	int			invert;
+	int			found;
+	int			failed;
+	char		*line;
+	size_t		len;
+	size_t		cap;
+	char		*obuf;
+	size_t		olen;
+}	t_grep;
+
+// selected lines are batched, one write() per BUILTIN_BUF of output
+static int	grep_line(t_grep *g, int out, const char *s, size_t len)
+{
+	int	ret;
+
+	if ((memmem(s, len, g->pat, g->plen) != NULL) == g->invert)
+		return (0);
+	g->found = 1;
+	if (g->olen + len > BUILTIN_BUF)
+	{
+		ret = write_all(out, g->obuf, g->olen);
+		g->olen = 0;
+		if (ret)
+			return (ret);
+	}
+	if (len > BUILTIN_BUF)
+		return (write_all(out, s, len));
+	memcpy(g->obuf + g->olen, s, len);
+	g->olen += len;
+	return (0);
+}
+
+// the start of a line that straddles two reads waits in g->line
+static int	grep_keep(t_grep *g, const char *s, size_t n)
+{
+	char	*tmp;
+
+	if (n == 0)
+		return (0);
+	if (g->len + n > g->cap)
+	{
+		tmp = realloc(g->line, (g->len + n) * 2);
+		if (!tmp)
+			return (1);
+		g->line = tmp;
+		g->cap = (g->len + n) * 2;
+	}
+	memcpy(g->line + g->len, s, n);
+	g->len += n;
+	return (0);
+}
+
+static int	grep_feed(t_grep *g, int out, const char *buf, size_t n)
+{
+	const char	*nl;
+	int			ret;
+
+	while ((nl = memchr(buf, '\n', n)) != NULL)
+	{
+		if (g->len && grep_keep(g, buf, nl - buf + 1))
+			return (1);
+		if (g->len)
+			ret = grep_line(g, out, g->line, g->len);
+		else
+			ret = grep_line(g, out, buf, nl - buf + 1);
+		g->len = 0;
+		if (ret)
+			return (ret);
+		n -= nl - buf + 1;
+		buf = nl + 1;
+	}
+	return (grep_keep(g, buf, n));
+}
+
+static int	grep_run(char **argv, int in, int out)
+{
+	t_grep	g;
+	char	*buf;
+	ssize_t	n;
+	int		ret;
+
+	n = 0;
+	memset(&g, 0, sizeof(g));
+	g.invert = (strcmp(argv[1], "-Fv") == 0 || strcmp(argv[2], "-v") == 0);
+	g.pat = argv[strcmp(argv[2], "-v") == 0 ? 3 : 2];
+	g.plen = strlen(g.pat);
+	buf = malloc(BUILTIN_BUF);
+	g.obuf = malloc(BUILTIN_BUF);
+	ret = (!buf || !g.obuf);
+	while (!ret && (n = read_some(in, buf, BUILTIN_BUF)) > 0)
+		ret = grep_feed(&g, out, buf, n);
+	// lines already selected are still printed, then exit 2
+	g.failed = (!ret && n == -1);
+	if (g.failed)
+		dprintf(STDERR_FILENO, "grep: (standard input): %s\n", strerror(errno));
+	// like grep, a last line without '\n' gets one
+	if (!ret && g.len)
+		ret = grep_feed(&g, out, "\n", 1);
+	if (!ret && g.olen)
+		ret = write_all(out, g.obuf, g.olen);
+	free(buf);
+	free(g.obuf);
+	free(g.line);
+	if (ret || g.failed)
+		return (ret == PICOSHELL_EPIPE ? ret : 2);
+	return (g.found ? 0 : 1);
+}
+
+static t_builtin		g_builtins[PICOSHELL_MAX_BUILTINS] = {
+	{"cat", cat_accepts, cat_run},
+	{"head", head_accepts, head_run},
+	{"wc", wc_accepts, wc_run},
+	{"grep", grep_accepts, grep_run},
+};
+static int				g_nbuiltins = 4;
+static int				g_enabled = 1;
+static pthread_mutex_t	g_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// replaces a builtin of the same name, -1 when the table is full
+int	picoshell_register_builtin(const t_builtin *b)
+{
+	int	i;
+
+	pthread_mutex_lock(&g_lock);
+	i = 0;
+	while (i < g_nbuiltins && strcmp(g_builtins[i].name, b->name))
+		i++;
+	if (i < PICOSHELL_MAX_BUILTINS)
+		g_builtins[i] = *b;
+	if (i == g_nbuiltins && i < PICOSHELL_MAX_BUILTINS)
+		g_nbuiltins++;
+	pthread_mutex_unlock(&g_lock);
+	return (i < PICOSHELL_MAX_BUILTINS ? 0 : -1);
+}
+
+void	picoshell_set_builtins(int enabled)
+{
+	pthread_mutex_lock(&g_lock);
+	g_enabled = enabled;
+	pthread_mutex_unlock(&g_lock);
+}
+
+// only bare names match: "/bin/cat" asks for that binary, not for ours
+int	picoshell_find_builtin(char **argv, t_builtin *out)
+{
+	int	i;
+	int	found;
+
+	if (!argv[0] || strchr(argv[0], '/'))
+		return (0);
+	found = 0;
+	pthread_mutex_lock(&g_lock);
+	i = -1;
+	while (g_enabled && !found && ++i < g_nbuiltins)
+	{
+		if (strcmp(g_builtins[i].name, argv[0]) == 0
+			&& g_builtins[i].accepts(argv))
+		{
+			*out = g_builtins[i];
+			found = 1;
+		}
+	}
+	pthread_mutex_unlock(&g_lock);
+	return (found);
+}
@@ -0,0 +1,314 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include "picoshell.h"
+
+// The same walk runs twice: once with out == NULL to size the arena,
+// then again to fill it. Tokens follow sh quoting: '...' is literal,
+// "..." only lets \ escape " \ $ and `, a bare \ escapes anything, and
+// outside '...' a \ before a newline drops both (a line continuation).
+// in_stage/out_stage are the stages the last "<" and ">" were seen in,
+// -1 for none.
+typedef struct s_scan
+{
+	char		***cmds;
+	char		**argv;
+	char		*str;
+	int			stages;
+	int			tokens;
+	size_t		bytes;
+	const char	*in;
+	const char	*out;
+	int			append;
+	int			in_stage;
+	int			out_stage;
+}	t_scan;
+
+static void	scan_init(t_scan *sc)
+{
+	memset(sc, 0, sizeof(*sc));
+	sc->in_stage = -1;
+	sc->out_stage = -1;
+}
+
+static void	put(t_scan *sc, char c)
+{
+	if (sc->str)
+		*sc->str++ = c;
+	sc->bytes++;
+}
+
+static int	is_blank(char c)
+{
+	return (c == ' ' || c == '\t' || c == '\n');
+}
+
+// blanks and line continuations between words
+static const char	*skip_blanks(const char *s)
+{
+	while (is_blank(*s) || (*s == '\\' && s[1] == '\n'))
+		s += 1 + (*s == '\\');
+	return (s);
+}
+
+static int	ends_word(char c)
+{
+	return (!c || is_blank(c) || c == '|' || c == '<' || c == '>');
+}
+
+// "2>file" or "1<file": sh would redirect that fd, which picoshell
+// cannot do, so it is an error rather than the word "2" and "> file"
+static int	is_fd_prefix(const char *s)
+{
+	const char	*p;
+
+	p = s;
+	while ((*p >= '0' && *p <= '9') || (*p == '\\' && p[1] == '\n'))
+		p += 1 + (*p == '\\');
+	return (*s >= '0' && *s <= '9' && (*p == '<' || *p == '>'));
+}
+
+// one word into the arena, NULL on an unterminated quote
+static const char	*scan_word(const char *s, t_scan *sc)
+{
+	char	quote;
+
+	quote = 0;
+	while (*s && (quote || !ends_word(*s)))
+	{
+		if (!quote && (*s == '\'' || *s == '"'))
+			quote = *s++;
+		else if (quote && *s == quote)
+		{
+			quote = 0;
+			s++;
+		}
+		else if (*s == '\\' && quote != '\'' && s[1] == '\n')
+			s += 2;
+		else if (*s == '\\' && quote != '\'' && s[1]
+			&& (!quote || strchr("\"\\$`", s[1])))
+		{
+			put(sc, s[1]);
+			s += 2;
+		}
+		else
+			put(sc, *s++);
+	}
+	put(sc, '\0');
+	return (quote ? NULL : s);
+}
+
+// "< file", "> file" or ">> file": the file goes to the arena but not to
+// argv. A second ">" in another stage means one of them is not the last.
+static const char	*scan_redir(const char *s, t_scan *sc)
+{
+	int	out;
+
+	out = (*s == '>');
+	sc->append = out ? (s[1] == '>') : sc->append;
+	s = skip_blanks(s + 1 + (out && s[1] == '>'));
+	if (ends_word(*s))
+		return (NULL);
+	if (out && sc->out_stage != -1 && sc->out_stage != sc->stages)
+		return (NULL);
+	if (out)
+	{
+		sc->out = sc->str;
+		sc->out_stage = sc->stages;
+	}
+	else
+	{
+		sc->in = sc->str;
+		sc->in_stage = sc->stages;
+	}
+	return (scan_word(s, sc));
+}
+
+// closes the current stage, an empty one ("| a", "a || b", "a |") is
+// a syntax error
+static int	end_stage(t_scan *sc, int words)
+{
+	if (words == 0)
+		return (-1);
+	if (sc->argv)
+		*sc->argv++ = NULL;
+	sc->stages++;
+	return (0);
+}
+
+static int	scan_line(const char *s, t_scan *sc)
+{
+	int	words;
+
+	words = 0;
+	if (sc->cmds)
+		sc->cmds[0] = sc->argv;
+	while (1)
+	{
+		s = skip_blanks(s);
+		if (!*s || *s == '|')
+		{
+			if (end_stage(sc, words) == -1)
+				return (-1);
+			if (!*s++)
+				break ;
+			if (sc->cmds)
+				sc->cmds[sc->stages] = sc->argv;
+			words = 0;
+			continue ;
+		}
+		if (*s == '<' || *s == '>')
+			s = scan_redir(s, sc);
+		else if (is_fd_prefix(s))
+			s = NULL;
+		else
+		{
+			if (sc->argv)
+				*sc->argv++ = sc->str;
+			sc->tokens++;
+			words++;
+			s = scan_word(s, sc);
+		}
+		if (!s)
+			return (-1);
+	}
+	return (sc->in_stage > 0
+		|| (sc->out_stage != -1 && sc->out_stage != sc->stages - 1) ? -1 : 0);
+}
+
+// Everything lives in one malloc'd block: the t_pipeline, cmds, every
+// argv array, every string and a copy of line, so picoshell_free() is a
+// single free(). Returns NULL with errno EINVAL on a syntax error (empty
+// stage, unterminated quote, missing file name, "<" past the first stage,
+// ">" before the last one or an fd-prefixed "2>"), ENOMEM if the block
+// could not be allocated.
+t_pipeline	*picoshell_parse(const char *line)
+{
+	t_pipeline	*p;
+	t_scan		sc;
+	size_t		ptrs;
+
+	scan_init(&sc);
+	if (!line || scan_line(line, &sc) == -1)
+	{
+		errno = EINVAL;
+		return (NULL);
+	}
+	ptrs = (sc.stages + 1) + (sc.tokens + sc.stages);
+	p = malloc(sizeof(t_pipeline) + ptrs * sizeof(char *) + sc.bytes
+			+ strlen(line) + 1);
+	if (!p)
+		return (NULL);
+	p->cmds = (char ***)(p + 1);
+	p->ncmds = sc.stages;
+	p->refs = 1;
+	scan_init(&sc);
+	sc.cmds = p->cmds;
+	sc.argv = (char **)(p->cmds + p->ncmds + 1);
+	sc.str = (char *)((char **)(p + 1) + ptrs);
+	scan_line(line, &sc);
+	p->cmds[p->ncmds] = NULL;
+	p->redir.in = sc.in;
+	p->redir.out = sc.out;
+	p->redir.append = sc.append;
+	p->redir.flags = 0;
+	p->line = strcpy(sc.str, line);
+	return (p);
+}
+
+void	picoshell_free(t_pipeline *p)
+{
+	free(p);
+}
+
+// Parsed pipelines keyed by their source string, direct-mapped like the
+// PATH cache. refs counts the cache's own reference plus every run in
+// progress, so a slot can be replaced while another thread still runs
+// the pipeline it held: the last one out frees it.
+static t_pipeline		*g_cache[PICOSHELL_CACHE_SLOTS];
+static pthread_mutex_t	g_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static unsigned int	line_hash(const char *s)
+{
+	unsigned int	h;
+
+	h = 5381;
+	while (*s)
+		h = h * 33 + (unsigned char)*s++;
+	return (h % PICOSHELL_CACHE_SLOTS);
+}
+
+static void	pipeline_unref(t_pipeline *p)
+{
+	int	last;
+
+	pthread_mutex_lock(&g_lock);
+	last = (--p->refs == 0);
+	pthread_mutex_unlock(&g_lock);
+	if (last)
+		picoshell_free(p);
+}
+
+static t_pipeline	*cache_get(const char *line)
+{
+	t_pipeline		*p;
+	t_pipeline		*old;
+	unsigned int	h;
+	int				hit;
+
+	h = line_hash(line);
+	pthread_mutex_lock(&g_lock);
+	p = g_cache[h];
+	hit = (p && strcmp(p->line, line) == 0);
+	if (hit)
+		p->refs++;
+	pthread_mutex_unlock(&g_lock);
+	if (hit)
+		return (p);
+	p = picoshell_parse(line);
+	if (!p)
+		return (NULL);
+	pthread_mutex_lock(&g_lock);
+	old = g_cache[h];
+	g_cache[h] = p;
+	p->refs++;
+	if (old && --old->refs == 0)
+		picoshell_free(old);
+	pthread_mutex_unlock(&g_lock);
+	return (p);
+}
+
+// picoshell_redir() on a command line; the parse is cached, so running the
+// same line again costs no allocation. Returns 1 on a syntax error too.
+int	picoshell_run(const char *line, t_stage_report *reports)
+{
+	t_pipeline	*p;
+	int			ret;
+
+	if (!line)
+		return (1);
+	p = cache_get(line);
+	if (!p)
+		return (1);
+	ret = picoshell_redir(p->cmds, &p->redir, reports);
+	pipeline_unref(p);
+	return (ret);
+}
+
+void	picoshell_cache_flush(void)
+{
+	t_pipeline	*p;
+	int			i;
+
+	i = -1;
+	while (++i < PICOSHELL_CACHE_SLOTS)
+	{
+		pthread_mutex_lock(&g_lock);
+		p = g_cache[i];
+		g_cache[i] = NULL;
+		pthread_mutex_unlock(&g_lock);
+		if (p)
+			pipeline_unref(p);
+	}
+}
@@ -7,24 +7,65 @@
 #include <sys/wait.h>
 #include <sys/types.h>
 #include <string.h>
+#include <limits.h>
+#include "../common/ft_pidfd.h"
 
-//static pid_t child_pid;
+// the child's exit is watched through a pidfd: no SIGALRM handler to
+// install, and the kill on timeout cannot hit a recycled pid. The
+// SIGALRM way is only kept for kernels without pidfds.
 
-void alarm_handler(int sig)
+static void alarm_handler(int sig)
 {
     (void)sig;
 }
 
-int sandbox(void (*f)(void), unsigned int timeout, bool verbose)
+// Without pidfds (ENOSYS before Linux 5.3, or no fd left) the old way:
+// SIGALRM interrupts waitpid. Same return values as ft_pidfd_wait_kill.
+static int wait_alarm(pid_t pid, unsigned int timeout, int *status)
 {
     struct sigaction sa;
-    pid_t pid;
-    int status;
+    struct sigaction old;
+    int ret;
 
     sa.sa_handler = alarm_handler;
     sa.sa_flags = 0;
     sigemptyset(&sa.sa_mask);
-    sigaction(SIGALRM, &sa, NULL);
+    sigaction(SIGALRM, &sa, &old);
+    alarm(timeout);
+    ret = FT_PIDFD_EXITED;
+    if(waitpid(pid, status, 0) == -1)
+    {
+        ret = (errno == EINTR) ? FT_PIDFD_TIMEOUT : -1;
+        kill(pid, SIGKILL);
+        waitpid(pid, NULL, 0);
+    }
+    alarm(0);
+    sigaction(SIGALRM, &old, NULL);
+    return (ret);
+}
+
+// alarm(0) never fires, keep that meaning for timeout == 0; past INT_MAX
+// ms (~24 days) poll() could not take it, which is as good as forever
+static int wait_child(pid_t pid, unsigned int timeout, int *status)
+{
+    int pidfd;
+    int timeout_ms;
+
+    pidfd = ft_pidfd_open(pid);
+    if(pidfd == -1)
+        return (wait_alarm(pid, timeout, status));
+    timeout_ms = -1;
+    if(timeout)
+        timeout_ms = timeout > INT_MAX / 1000 ? INT_MAX : (int)timeout * 1000;
+    // on a poll() failure the child is still killed and reaped, then -1
+    return (ft_pidfd_wait_kill(pidfd, timeout_ms, status));
+}
+
+int sandbox(void (*f)(void), unsigned int timeout, bool verbose)
+{
+    pid_t pid;
+    int status;
+    int ret;
 
     pid = fork();
     if(pid == -1)
@@ -34,19 +75,14 @@ int sandbox(void (*f)(void), unsigned int timeout, bool verbose)
         f();
         exit(0);
     }
-   // child_pid = pid;
-    alarm(timeout);
-    if(waitpid(pid, &status, 0) == -1)
-    {
-        if(errno == EINTR)
-        {
-            kill(pid, SIGKILL);
-            waitpid(pid, NULL, 0);
-            if(verbose)
-                printf("Bad function: timed out after %u seconds\n", timeout);
-            return(0);
-        }
+    ret = wait_child(pid, timeout, &status);
+    if(ret == -1)
         return (-1);
+    if(ret == FT_PIDFD_TIMEOUT)
+    {
+        if(verbose)
+            printf("Bad function: timed out after %u seconds\n", timeout);
+        return(0);
     }
     if(WIFEXITED(status))
     {
@@ -5,7 +5,7 @@ file1=sandbox.c
 file2=../../../../rendu/sandbox/sandbox.c
 
 # Compile reference and user solutions
-gcc -Werror -Wall -Wextra -o out1 main.c "$file1"
+gcc -Werror -Wall -Wextra -o out1 main.c "$file1" ../common/ft_pidfd.c
 gcc -Werror -Wall -Wextra -o out2 main.c "$file2"
 if [ $? -ne 0 ]; then
     echo "$(tput setaf 1)$(tput bold)COMPILATION FAILED$(tput sgr 0)"
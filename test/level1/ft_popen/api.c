@@ -0,0 +1,857 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <errno.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <linux/filter.h>
+#include <linux/seccomp.h>
+#include <pthread.h>
+#include <time.h>
+#include "leak_tracker.h"
+#include "../../../ran04/level1/ft_popen/ft_popen.h"
+#include "../../../ran04/level1/common/ft_pathcache.h"
+
+// Behavior tests for the ft_popen extensions (main.c covers ft_popen
+// itself). Every check prints one ✅/❌ line, any ❌ or leak fails.
+// Build: gcc -pthread -o test_api api.c leak_tracker.c <ft_popen sources
+//        without main.c> ../../../ran04/level1/common/ft_pathcache.c
+//        ../../../ran04/level1/common/ft_pidfd.c
+
+static int g_failed = 0;
+
+static void check(int ok, const char *what) {
+    printf("%s %s\n", ok ? "✅" : "❌", what);
+    if (!ok)
+        g_failed++;
+}
+
+static int fd_is_open(int fd) {
+    return fcntl(fd, F_GETFD) != -1;
+}
+
+void test_pump() {
+    printf("\n=== Testing ft_popen2_pump ===\n");
+
+    size_t len = 3 * 1024 * 1024;
+    char *in = malloc(len);
+    for (size_t i = 0; i < len; i++)
+        in[i] = 'a' + i % 26;
+
+    // more than a pipe's worth each way, through a filter that echoes it
+    char *cat[] = {"cat", NULL};
+    int fd[2];
+    char *out;
+    int status;
+    check(ft_popen2("cat", cat, fd) == 0, "pump: ft_popen2 cat");
+    int in_fd = fd[1];
+    ssize_t n = ft_popen2_pump(fd, in, len, &out);
+    check(n == (ssize_t)len && memcmp(out, in, len) == 0, "pump: 3 MiB through cat comes back intact");
+    check(fd[1] == -1 && !fd_is_open(in_fd), "pump: fd[1] closed after a full write");
+    status = ft_pclose(fd[0]);
+    check(WIFEXITED(status) && WEXITSTATUS(status) == 0, "pump: cat exits 0");
+    free(out);
+
+    // the child stops reading after 10 bytes: we must not die of SIGPIPE
+    pid_t pid = fork();
+    if (pid == 0) {
+        char *head[] = {"head", "-c", "10", NULL};
+        int cfd[2];
+        char *cout;
+        if (ft_popen2("head", head, cfd) == -1)
+            _exit(2);
+        int cin = cfd[1];
+        ssize_t got = ft_popen2_pump(cfd, in, len, &cout);
+        int ok = got == 10 && memcmp(cout, in, 10) == 0 && cfd[1] == -1 && !fd_is_open(cin);
+        sigset_t pending;
+        sigpending(&pending);
+        ft_pclose(cfd[0]);
+        _exit(ok && !sigismember(&pending, SIGPIPE) ? 0 : 1);
+    }
+    waitpid(pid, &status, 0);
+    check(WIFEXITED(status), "pump: head -c 10 on 3 MiB does not kill us with SIGPIPE");
+    check(WIFEXITED(status) && WEXITSTATUS(status) == 0, "pump: head -c 10 returns its 10 bytes, fd[1] closed, no SIGPIPE left pending");
+    free(in);
+}
+
+// bytes `seq 1 n` prints
+static size_t seq_bytes(int n) {
+    char num[32];
+    size_t total = 0;
+
+    for (int i = 1; i <= n; i++)
+        total += snprintf(num, sizeof(num), "%d\n", i);
+    return total;
+}
+
+static int file_has_seq(const char *path, int n) {
+    FILE *f = fopen(path, "r");
+    int v;
+    int i = 0;
+
+    if (f == NULL)
+        return 0;
+    while (fscanf(f, "%d", &v) == 1 && v == i + 1)
+        i++;
+    fclose(f);
+    return i == n;
+}
+
+// splice for pipe -> file, sendfile when neither end is a pipe (a
+// regular file into a socket), read/write for an O_APPEND file which
+// both of them refuse
+void test_drain() {
+    printf("\n=== Testing ft_popen_drain ===\n");
+
+    char *seq[] = {"seq", "1", "100000", NULL};
+    size_t want = seq_bytes(100000);
+    t_drain_stats st;
+    struct stat sb;
+    char msg[160];
+
+    int out = open("/tmp/ft_popen_drain_1", O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    int fd = ft_popen("seq", seq, 'r');
+    ssize_t n = ft_popen_drain(fd, out, &st);
+    snprintf(msg, sizeof(msg), "drain: pipe -> file moves %zu bytes by splice (got %zd, method %d)", want, n, st.method);
+    check(n == (ssize_t)want && st.bytes == want && st.method == FT_DRAIN_SPLICE, msg);
+    ft_pclose(fd);
+    close(out);
+    check(stat("/tmp/ft_popen_drain_1", &sb) == 0 && (size_t)sb.st_size == want
+          && file_has_seq("/tmp/ft_popen_drain_1", 100000), "drain: spliced file holds the whole output");
+
+    out = open("/tmp/ft_popen_drain_2", O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+    fd = ft_popen("seq", seq, 'r');
+    n = ft_popen_drain(fd, out, &st);
+    snprintf(msg, sizeof(msg), "drain: pipe -> O_APPEND file moves %zu bytes by read/write (got %zd, method %d)", want, n, st.method);
+    check(n == (ssize_t)want && st.bytes == want && st.method == FT_DRAIN_COPY, msg);
+    ft_pclose(fd);
+    close(out);
+    check(file_has_seq("/tmp/ft_popen_drain_2", 100000), "drain: copied file holds the whole output");
+
+    // small enough for the socket buffer, read back once drain returns
+    char *seq_small[] = {"seq", "1", "5000", NULL};
+    size_t small = seq_bytes(5000);
+    int sv[2];
+    socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv);
+    out = open("/tmp/ft_popen_drain_3", O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    fd = ft_popen("seq", seq_small, 'r');
+    ft_popen_drain(fd, out, NULL);
+    ft_pclose(fd);
+    close(out);
+    int in = open("/tmp/ft_popen_drain_3", O_RDONLY | O_CLOEXEC);
+    n = ft_popen_drain(in, sv[0], &st);
+    snprintf(msg, sizeof(msg), "drain: file -> socket moves %zu bytes by sendfile (got %zd, method %d)", small, n, st.method);
+    check(n == (ssize_t)small && st.bytes == small && st.method == FT_DRAIN_SENDFILE, msg);
+    close(in);
+    close(sv[0]);
+    char *buf = malloc(small + 1);
+    size_t got = 0;
+    while ((n = read(sv[1], buf + got, small + 1 - got)) > 0)
+        got += n;
+    check(got == small && memcmp(buf, "1\n2\n3\n", 6) == 0, "drain: the socket receives every byte");
+    free(buf);
+    close(sv[1]);
+
+    fd = ft_popen("true", (char *[]){"true", NULL}, 'r');
+    out = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    check(ft_popen_drain(fd, out, &st) == 0 && st.bytes == 0, "drain: empty output moves 0 bytes");
+    ft_pclose(fd);
+    close(out);
+    unlink("/tmp/ft_popen_drain_1");
+    unlink("/tmp/ft_popen_drain_2");
+    unlink("/tmp/ft_popen_drain_3");
+}
+
+static long elapsed_ms(const struct timespec *t0) {
+    struct timespec t1;
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    return (t1.tv_sec - t0->tv_sec) * 1000 + (t1.tv_nsec - t0->tv_nsec) / 1000000;
+}
+
+static pid_t parent_of(pid_t pid) {
+    char path[64];
+    int ppid = -1;
+    FILE *f;
+
+    snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+    f = fopen(path, "r");
+    if (!f)
+        return -1;
+    if (fscanf(f, "%*d (%*[^)]) %*c %d", &ppid) != 1)
+        ppid = -1;
+    fclose(f);
+    return ppid;
+}
+
+// waits up to ms for pid to have no child left, reaped zombies included
+static int children_gone(pid_t pid, int ms) {
+    char path[96];
+    char buf[64];
+
+    snprintf(path, sizeof(path), "/proc/%d/task/%d/children", (int)pid, (int)pid);
+    for (int i = 0; i < ms / 10; i++) {
+        FILE *f = fopen(path, "r");
+        size_t n;
+
+        if (!f)
+            return 0;
+        n = fread(buf, 1, sizeof(buf), f);
+        fclose(f);
+        if (n == 0)
+            return 1;
+        usleep(10 * 1000);
+    }
+    return 0;
+}
+
+static void *zygote_close_slow(void *arg) {
+    return (void *)(long)ft_pclose(*(int *)arg);
+}
+
+// while one thread sits in ft_pclose on a zygote child that runs for a
+// second, the others must still be able to spawn and reap through it
+void test_zygote() {
+    printf("\n=== Testing ft_zygote_popen ===\n");
+
+    char *sleep_args[] = {"sleep", "1", NULL};
+    char *echo_args[] = {"echo", "zygote", NULL};
+    struct timespec t0;
+    pthread_t th;
+    void *ret;
+    char buf[16];
+    int ok = 1;
+
+    check(ft_zygote_start() == 0, "zygote: helper started");
+    int slow = ft_zygote_popen("sleep", sleep_args, 'r');
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    pthread_create(&th, NULL, zygote_close_slow, &slow);
+    usleep(100 * 1000);
+    for (int i = 0; i < 10 && ok; i++) {
+        int fd = ft_zygote_popen("echo", echo_args, 'r');
+        ok = fd != -1 && read(fd, buf, sizeof(buf)) == 7 && memcmp(buf, "zygote\n", 7) == 0;
+        int status = ft_pclose(fd);
+        ok = ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    }
+    check(ok && elapsed_ms(&t0) < 800, "zygote: 10 spawn/reap cycles while another reap waits on sleep 1");
+    pthread_join(th, &ret);
+    check(WIFEXITED((int)(long)ret) && WEXITSTATUS((int)(long)ret) == 0 && elapsed_ms(&t0) >= 800,
+          "zygote: the slow reap gets sleep's status once it exits");
+
+    // the reply carries the pipe end: with no fd number left to put it
+    // in, the spawn fails and the child must not stay behind
+    char *long_args[] = {"sleep", "100", NULL};
+    struct rlimit rl;
+    struct rlimit low;
+    int probe = ft_zygote_popen("echo", echo_args, 'r');
+    pid_t helper = parent_of(ft_popen_pid(probe));
+    ok = read(probe, buf, sizeof(buf)) == 7;
+    ft_pclose(probe);
+    getrlimit(RLIMIT_NOFILE, &rl);
+    low = rl;
+    low.rlim_cur = dup(0);
+    close(low.rlim_cur);
+    setrlimit(RLIMIT_NOFILE, &low);
+    errno = 0;
+    probe = ft_zygote_popen("sleep", long_args, 'r');
+    int err = errno;
+    setrlimit(RLIMIT_NOFILE, &rl);
+    check(ok && probe == -1 && err == EMFILE, "zygote: EMFILE when the stream fd cannot be received");
+    check(helper > 0 && children_gone(helper, 2000), "zygote: that child is killed and reaped");
+
+    ft_zygote_stop();
+    // read before closing, or echo may die of SIGPIPE
+    int fd = ft_zygote_popen("echo", echo_args, 'r');
+    check(fd != -1 && read(fd, buf, sizeof(buf)) == 7 && ft_pclose(fd) == 0,
+          "zygote: restarts on demand after ft_zygote_stop");
+    ft_zygote_stop();
+}
+
+typedef struct s_loop_ctx {
+    t_popen_loop *loop;
+    size_t bytes;
+    int reads;
+    int eofs;
+    int victim;     // fd removed by this stream's first read, -1 for none
+    int self_del;   // this stream removes itself on its first read
+} t_loop_ctx;
+
+static void loop_on_read(int fd, void *arg) {
+    t_loop_ctx *c = arg;
+    char buf[4096];
+    ssize_t n;
+
+    while ((n = read(fd, buf, sizeof(buf))) > 0)
+        c->bytes += n;
+    c->reads++;
+    if (c->victim != -1) {
+        ft_loop_del(c->loop, c->victim);
+        ft_pclose(c->victim);
+        c->victim = -1;
+    }
+    if (c->self_del) {
+        ft_loop_del(c->loop, fd);
+        ft_pclose(fd);
+    }
+}
+
+static void loop_on_eof(int fd, void *arg) {
+    ((t_loop_ctx *)arg)->eofs++;
+    ft_pclose(fd);
+}
+
+static int loop_spawn(char *const argv[]) {
+    t_popen_opts opts = {.flags = FT_POPEN_NONBLOCK};
+
+    return ft_popen_ex(argv[0], argv, 'r', &opts);
+}
+
+void test_loop() {
+    printf("\n=== Testing ft_loop ===\n");
+
+    const t_popen_events ev = {loop_on_read, NULL, loop_on_eof};
+    char *seq[] = {"seq", "1", "20000", NULL};
+    char *sleep_args[] = {"sleep", "5", NULL};
+    t_popen_loop *loop = ft_loop_new();
+    t_loop_ctx c[4];
+    int fds[4];
+
+    // every stream read to the end, one on_eof each, then run returns 0
+    for (int i = 0; i < 4; i++) {
+        memset(&c[i], 0, sizeof(c[i]));
+        c[i].loop = loop;
+        c[i].victim = -1;
+        fds[i] = loop_spawn(seq);
+        ft_loop_add(loop, fds[i], &ev, &c[i]);
+    }
+    int ret = ft_loop_run(loop, 5000);
+    int ok = ret == 0;
+    for (int i = 0; i < 4; i++)
+        ok = ok && c[i].bytes == seq_bytes(20000) && c[i].eofs == 1;
+    check(ok, "loop: 4 streams read to EOF, on_eof once each, run returns 0");
+
+    // the first read of stream 0 removes stream 1 (its data is ready in
+    // the same batch) and stream 2 removes itself: neither may be called
+    // again, not even on_eof
+    for (int i = 0; i < 3; i++) {
+        memset(&c[i], 0, sizeof(c[i]));
+        c[i].loop = loop;
+        c[i].victim = -1;
+        fds[i] = loop_spawn(seq);
+    }
+    c[0].victim = fds[1];
+    c[2].self_del = 1;
+    usleep(100 * 1000);
+    for (int i = 0; i < 3; i++)
+        ft_loop_add(loop, fds[i], &ev, &c[i]);
+    ret = ft_loop_run(loop, 5000);
+    check(ret == 0 && c[0].eofs == 1 && c[0].bytes == seq_bytes(20000),
+          "loop: the remover still reads its own stream to EOF");
+    check(c[1].reads + c[1].eofs <= 1 && c[1].eofs == 0,
+          "loop: a stream removed by another callback gets no more calls");
+    check(c[2].reads == 1 && c[2].eofs == 0, "loop: a stream removing itself gets no on_eof");
+    check(ft_loop_del(loop, fds[2]) == -1 && errno == ENOENT, "loop: removing it again fails with ENOENT");
+
+    // nothing happens within the timeout: the stream is still there
+    memset(&c[0], 0, sizeof(c[0]));
+    c[0].victim = -1;
+    fds[0] = loop_spawn(sleep_args);
+    ft_loop_add(loop, fds[0], &ev, &c[0]);
+    check(ft_loop_add(loop, fds[0], &ev, &c[0]) == -1 && errno == EEXIST, "loop: adding an fd twice fails with EEXIST");
+    check(ft_loop_run(loop, 50) == 1 && c[0].eofs == 0, "loop: timeout returns the streams left");
+    ft_loop_del(loop, fds[0]);
+    kill(ft_popen_pid(fds[0]), SIGKILL);
+    ft_pclose(fds[0]);
+    ft_loop_free(loop);
+}
+
+// Each command prints how many of its peers are running when it starts
+// (a file per running peer in the directory), so no output may reach
+// max_parallel; the timing shows they did run max_parallel at a time.
+void test_many() {
+    printf("\n=== Testing ft_popen_many ===\n");
+
+    const char *script = "n=$(ls /tmp/ft_popen_many | wc -l); touch /tmp/ft_popen_many/$$;"
+                         " sleep 0.2; rm /tmp/ft_popen_many/$$; echo \"$n $0\"";
+    char names[8][8];
+    char *cmd[8][5];
+    char **cmds[9];
+    t_popen_result res[9];
+    struct timespec t0;
+    char want[16];
+    int ok = 1;
+    int peers = 0;
+
+    mkdir("/tmp/ft_popen_many", 0755);
+    for (int i = 0; i < 8; i++) {
+        snprintf(names[i], sizeof(names[i]), "job%d", i);
+        cmd[i][0] = "sh";
+        cmd[i][1] = "-c";
+        cmd[i][2] = (char *)script;
+        cmd[i][3] = names[i];
+        cmd[i][4] = NULL;
+        cmds[i] = cmd[i];
+    }
+    cmds[8] = (char *[]){"false", NULL};
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    check(ft_popen_many(cmds, 9, 3, res) == 0, "many: 9 commands, 3 at a time");
+    long ms = elapsed_ms(&t0);
+    for (int i = 0; i < 8; i++) {
+        int n = -1;
+        snprintf(want, sizeof(want), "job%d\n", i);
+        sscanf(res[i].out, "%d", &n);
+        ok = ok && strstr(res[i].out, want) && res[i].len == strlen(res[i].out)
+             && WIFEXITED(res[i].status) && WEXITSTATUS(res[i].status) == 0;
+        if (n > peers)
+            peers = n;
+    }
+    check(ok, "many: results[i] holds command i's output and status");
+    check(peers < 3, "many: never more than max_parallel children alive");
+    check(ms >= 550 && ms < 1500, "many: 8 x sleep 0.2 at 3 wide takes 3 rounds");
+    check(WIFEXITED(res[8].status) && WEXITSTATUS(res[8].status) == 1 && res[8].len == 0
+          && res[8].out && res[8].out[0] == '\0', "many: a failing command gets its status and an empty output");
+    for (int i = 0; i < 9; i++)
+        free(res[i].out);
+    rmdir("/tmp/ft_popen_many");
+    check(ft_popen_many(cmds, 9, 0, res) == -1, "many: max_parallel 0 is refused");
+}
+
+// a grandchild keeps stdout after sh exits: the size handed back must
+// still be the file's size once it has tried to write more
+void test_memfd() {
+    printf("\n=== Testing ft_popen_memfd ===\n");
+
+    char *args[] = {"sh", "-c", "echo hi; (sleep 0.3; echo late 2>/dev/null) &", NULL};
+    struct stat sb;
+    size_t size;
+    int status;
+    char buf[8];
+
+    int fd = ft_popen_memfd("sh", args, &size, &status);
+    check(fd != -1 && size == 3 && WIFEXITED(status), "memfd: output size and status");
+    usleep(500 * 1000);
+    check(fstat(fd, &sb) == 0 && (size_t)sb.st_size == size, "memfd: a late grandchild cannot grow it");
+    check(read(fd, buf, sizeof(buf)) == 3 && memcmp(buf, "hi\n", 3) == 0, "memfd: rewound to the start");
+    close(fd);
+}
+
+static int line_is(const t_line *l, char c, size_t len) {
+    for (size_t i = 0; i < l->len; i++) {
+        if (l->ptr[i] != c)
+            return 0;
+    }
+    return l->len == len;
+}
+
+void test_linereader() {
+    printf("\n=== Testing ft_lr_next ===\n");
+
+    // a 16-byte buffer: the 1000-byte line has to grow it, the last line
+    // has no '\n' and must still come out
+    char *args[] = {"sh", "-c", "printf 'short\\n%01000d\\n\\ntail' 0", NULL};
+    t_linereader lr;
+    t_line l;
+    int fd = ft_popen("sh", args, 'r');
+
+    check(ft_lr_init(&lr, fd, 16) == 0, "linereader: init with a 16-byte buffer");
+    check(ft_lr_next(&lr, &l) == 1 && l.len == 5 && memcmp(l.ptr, "short", 5) == 0, "linereader: first line without its '\\n'");
+    check(ft_lr_next(&lr, &l) == 1 && line_is(&l, '0', 1000), "linereader: a 1000-byte line through a 16-byte buffer");
+    check(ft_lr_next(&lr, &l) == 1 && l.len == 0, "linereader: an empty line");
+    check(ft_lr_next(&lr, &l) == 1 && l.len == 4 && memcmp(l.ptr, "tail", 4) == 0, "linereader: last line without '\\n'");
+    check(ft_lr_next(&lr, &l) == 0 && ft_lr_next(&lr, &l) == 0, "linereader: then 0, and 0 again");
+    ft_lr_free(&lr);
+    ft_pclose(fd);
+
+    // lines of every length from 0 to 199, so newlines land at every
+    // offset of the 16/32-byte scan blocks
+    char ys[200];
+    memset(ys, 'y', sizeof(ys));
+    FILE *f = fopen("/tmp/ft_popen_lines", "w");
+    for (int i = 0; i < 200; i++)
+        fprintf(f, "%.*s\n", i, ys);
+    fclose(f);
+    int ok = 1;
+    int lines = 0;
+    fd = open("/tmp/ft_popen_lines", O_RDONLY | O_CLOEXEC);
+    ft_lr_init(&lr, fd, 0);
+    while (ft_lr_next(&lr, &l) == 1)
+        ok = ok && line_is(&l, 'y', lines++);
+    check(ok && lines == 200, "linereader: 200 lines of lengths 0..199");
+    ft_lr_free(&lr);
+    close(fd);
+    unlink("/tmp/ft_popen_lines");
+
+    fd = ft_popen("true", (char *[]){"true", NULL}, 'r');
+    ft_lr_init(&lr, fd, 0);
+    check(ft_lr_next(&lr, &l) == 0, "linereader: empty stream gives no line");
+    ft_lr_free(&lr);
+    ft_pclose(fd);
+}
+
+static int capture_head(const char *count, size_t cap, t_popen_result *res) {
+    char *args[] = {"head", "-c", (char *)count, "/dev/zero", NULL};
+
+    return ft_popen_capture("head", args, cap, res);
+}
+
+void test_capture() {
+    printf("\n=== Testing ft_popen_capture ===\n");
+
+    t_popen_result res;
+    char zeros[100] = {0};
+
+    check(capture_head("100", 100, &res) == 0 && res.len == 100 && !res.truncated
+          && memcmp(res.out, zeros, 100) == 0 && res.out[100] == '\0'
+          && WIFEXITED(res.status) && WEXITSTATUS(res.status) == 0,
+          "capture: exactly cap bytes is not truncated");
+    free(res.out);
+    check(capture_head("101", 100, &res) == 0 && res.len == 100 && res.truncated
+          && res.out[100] == '\0', "capture: cap + 1 bytes keeps cap and sets truncated");
+    free(res.out);
+    check(capture_head("99", 100, &res) == 0 && res.len == 99 && !res.truncated,
+          "capture: under the cap is not truncated");
+    free(res.out);
+
+    // a child that never stops is killed once the cap is reached
+    char *yes[] = {"yes", NULL};
+    check(ft_popen_capture("yes", yes, 4096, &res) == 0 && res.len == 4096 && res.truncated
+          && WIFSIGNALED(res.status) && WTERMSIG(res.status) == SIGKILL
+          && strncmp(res.out, "y\ny\n", 4) == 0, "capture: an endless writer is SIGKILLed at the cap");
+    free(res.out);
+}
+
+// `echo $$` prints a new pid on every run, so a repeated output can
+// only come from the cache
+void test_cache() {
+    printf("\n=== Testing ft_popen_cached ===\n");
+
+    char *pid[] = {"sh", "-c", "echo $$", NULL};
+    char *fail[] = {"sh", "-c", "echo $$; exit 3", NULL};
+    t_popen_cache_stats st0;
+    t_popen_cache_stats st;
+    t_popen_result a;
+    t_popen_result b;
+
+    ft_popen_cache_flush();
+    ft_popen_cache_stats(&st0);
+    ft_popen_cached(pid, 300, &a);
+    ft_popen_cached(pid, 300, &b);
+    ft_popen_cache_stats(&st);
+    check(strcmp(a.out, b.out) == 0 && b.status == 0, "cache: a second run within the TTL gets the same output");
+    check(st.hits == st0.hits + 1 && st.misses == st0.misses + 1 && st.entries == 1
+          && st.bytes > 0, "cache: one miss then one hit, one entry");
+    free(b.out);
+
+    usleep(400 * 1000);
+    ft_popen_cached(pid, 300, &b);
+    ft_popen_cache_stats(&st);
+    check(strcmp(a.out, b.out) != 0 && st.misses == st0.misses + 2 && st.hits == st0.hits + 1,
+          "cache: past the TTL the command runs again and counts a miss");
+    free(a.out);
+    free(b.out);
+
+    ft_popen_cached(fail, 1000, &a);
+    ft_popen_cached(fail, 1000, &b);
+    ft_popen_cache_stats(&st);
+    check(strcmp(a.out, b.out) != 0 && WEXITSTATUS(b.status) == 3 && st.entries == 1
+          && st.hits == st0.hits + 1, "cache: a non-zero exit is never cached");
+    free(a.out);
+    free(b.out);
+
+    ft_popen_cached(pid, 0, &a);
+    ft_popen_cached(pid, 0, &b);
+    ft_popen_cache_stats(&st);
+    check(strcmp(a.out, b.out) != 0 && st.misses == st0.misses + 4,
+          "cache: ttl 0 just runs the command, uncounted");
+    free(a.out);
+    free(b.out);
+
+    ft_popen_cache_limit(0);
+    ft_popen_cache_stats(&st);
+    check(st.entries == 0 && st.bytes == 0, "cache: a 0-byte limit empties it");
+    ft_popen_cache_limit(FT_POPEN_CACHE_BYTES);
+    ft_popen_cached(pid, 1000, &a);
+    ft_popen_cache_flush();
+    ft_popen_cache_stats(&st);
+    check(st.entries == 0 && st.bytes == 0 && st.misses == st0.misses + 5,
+          "cache: flush drops entries but keeps the counters");
+    free(a.out);
+}
+
+// FT_POPEN_EXECERR takes a different path on every backend: the errno
+// comes back through a pipe after fork, through shared memory after
+// vfork/clone, and from libc for posix_spawn
+void test_execerr() {
+    printf("\n=== Testing FT_POPEN_EXECERR ===\n");
+
+    const char *names[] = {"fork", "vfork", "posix", "clone"};
+    char *missing[] = {"ft_popen_no_such_cmd", NULL};
+    char *noexec[] = {"/etc/passwd", NULL};
+    char *echo_args[] = {"echo", "ok", NULL};
+    t_popen_opts opts = {FT_POPEN_EXECERR, 0, 0};
+    t_popen_opts with_pidfd = {FT_POPEN_EXECERR | FT_POPEN_PIDFD, 0, 0};
+    int saved = ft_popen_get_spawn();
+    char what[96];
+    char buf[8];
+
+    for (int b = FT_SPAWN_FORK; b <= FT_SPAWN_CLONE; b++) {
+        ft_popen_set_spawn(b);
+        errno = 0;
+        int fd = ft_popen_ex("ft_popen_no_such_cmd", missing, 'r', &opts);
+        int err = errno;
+        snprintf(what, sizeof(what), "execerr/%s: missing command -> -1, ENOENT", names[b]);
+        check(fd == -1 && err == ENOENT, what);
+
+        errno = 0;
+        fd = ft_popen_ex("/etc/passwd", noexec, 'w', &with_pidfd);
+        err = errno;
+        snprintf(what, sizeof(what), "execerr/%s: not executable -> -1, EACCES (pidfd dropped)", names[b]);
+        check(fd == -1 && err == EACCES, what);
+
+        fd = ft_popen_ex("echo", echo_args, 'r', &opts);
+        int ok = fd != -1 && read(fd, buf, sizeof(buf)) == 3 && memcmp(buf, "ok\n", 3) == 0;
+        snprintf(what, sizeof(what), "execerr/%s: a command that runs still gets its stream", names[b]);
+        check(ok && ft_pclose(fd) == 0, what);
+
+        fd = ft_popen_ex("ft_popen_no_such_cmd", missing, 'r', NULL);
+        int status = fd == -1 ? -1 : ft_pclose(fd);
+        snprintf(what, sizeof(what), "execerr/%s: without the flag, a stream whose child exits 1", names[b]);
+        check(fd != -1 && WIFEXITED(status) && WEXITSTATUS(status) == 1, what);
+    }
+    ft_popen_set_spawn(saved);
+}
+
+// one deadline run: spent is the ms between ft_popen_ex and ft_pclose
+typedef struct s_deadline {
+    ssize_t io;
+    int io_errno;
+    int status;
+    long spent;
+} t_deadline;
+
+static void deadline_run(char *const argv[], char type, long ms, t_deadline *d) {
+    t_popen_opts opts = {0, 0, ms};
+    struct timespec t0;
+    char buf[1024] = {0};
+    int fd;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    fd = ft_popen_ex(argv[0], argv, type, &opts);
+    d->io = 0;
+    d->io_errno = 0;
+    if (type == 'r')
+        while ((d->io = ft_popen_read(fd, buf, sizeof(buf))) > 0)
+            ;
+    else
+        while ((d->io = ft_popen_write(fd, buf, sizeof(buf))) > 0)
+            ;
+    d->io_errno = errno;
+    d->status = ft_pclose(fd);
+    d->spent = elapsed_ms(&t0);
+}
+
+// pidfd_open() answers ENOSYS from here on, as on a pre-5.3 kernel
+static int no_pidfd_open(void) {
+    struct sock_filter code[] = {
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(struct seccomp_data, nr)),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, SYS_pidfd_open, 0, 1),
+        BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ERRNO | ENOSYS),
+        BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW),
+    };
+    struct sock_fprog prog = {sizeof(code) / sizeof(code[0]), code};
+
+    if (prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) == -1)
+        return -1;
+    return prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &prog);
+}
+
+// Without pidfds a deadline cannot be enforced: ft_popen_ex must refuse
+// it with ENOSYS and leave no child behind, while FT_POPEN_PIDFD alone
+// still works (ft_popen_pidfd() just says -1). Runs in a child process
+// so the filter stays there; only fork creates the pidfd by pidfd_open.
+static void deadline_nopidfd(void) {
+    char *sleep_args[] = {"sleep", "5", NULL};
+    char *echo_args[] = {"echo", "ok", NULL};
+    t_popen_opts deadline = {0, 0, 200};
+    t_popen_opts pidfd = {FT_POPEN_PIDFD, 0, 0};
+    char buf[8];
+    int status;
+    pid_t pid;
+
+    fflush(stdout);
+    pid = fork();
+    if (pid == 0) {
+        g_failed = 0;
+        ft_popen_set_spawn(FT_SPAWN_FORK);
+        int filtered = no_pidfd_open() == 0 && syscall(SYS_pidfd_open, getpid(), 0) == -1
+                       && errno == ENOSYS;
+        check(filtered, "deadline: pidfd_open filtered to ENOSYS");
+        errno = 0;
+        int fd = ft_popen_ex("sleep", sleep_args, 'r', &deadline);
+        int err = errno;
+        check(fd == -1 && err == ENOSYS && waitpid(-1, NULL, WNOHANG) == -1 && errno == ECHILD,
+              "deadline: no pidfd -> -1, ENOSYS and the child is reaped");
+        fd = ft_popen_ex("echo", echo_args, 'r', &pidfd);
+        int ok = fd != -1 && ft_popen_pidfd(fd) == -1 && read(fd, buf, sizeof(buf)) == 3;
+        check(ok && ft_pclose(fd) == 0, "deadline: FT_POPEN_PIDFD alone still runs, pidfd -1");
+        fflush(stdout);
+        _exit(g_failed);
+    }
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status))
+        g_failed++;
+}
+
+// a child that never exits by itself: the deadline kills it whichever
+// of read, write or ft_pclose is waiting when it passes
+void test_deadline() {
+    printf("\n=== Testing deadlines ===\n");
+
+    const char *names[] = {"fork", "vfork", "posix", "clone"};
+    char *sleep_args[] = {"sleep", "5", NULL};
+    char *echo_args[] = {"echo", "ok", NULL};
+    int saved = ft_popen_get_spawn();
+    t_deadline d;
+    char what[128];
+
+    for (int b = FT_SPAWN_FORK; b <= FT_SPAWN_CLONE; b++) {
+        ft_popen_set_spawn(b);
+        deadline_run(sleep_args, 'r', 200, &d);
+        snprintf(what, sizeof(what), "deadline/%s: read -> ETIMEDOUT, killed after %ldms", names[b], d.spent);
+        check(d.io == -1 && d.io_errno == ETIMEDOUT && FT_WTIMEDOUT(d.status)
+              && WIFSIGNALED(d.status) && WTERMSIG(d.status) == SIGKILL
+              && d.spent >= 190 && d.spent < 1000, what);
+    }
+    ft_popen_set_spawn(saved);
+
+    // sleep never reads: the pipe fills, then the write waits for the deadline
+    deadline_run(sleep_args, 'w', 200, &d);
+    snprintf(what, sizeof(what), "deadline: write -> ETIMEDOUT, killed after %ldms", d.spent);
+    check(d.io == -1 && d.io_errno == ETIMEDOUT && FT_WTIMEDOUT(d.status)
+          && d.spent >= 190 && d.spent < 1000, what);
+
+    struct timespec t0;
+    t_popen_opts opts = {0, 0, 200};
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    int fd = ft_popen_ex("sleep", sleep_args, 'r', &opts);
+    int status = ft_pclose(fd);
+    long spent = elapsed_ms(&t0);
+    snprintf(what, sizeof(what), "deadline: ft_pclose alone kills at the deadline (%ldms)", spent);
+    check(fd != -1 && FT_WTIMEDOUT(status) && WTERMSIG(status) == SIGKILL
+          && spent >= 190 && spent < 1000, what);
+
+    deadline_run(echo_args, 'r', 2000, &d);
+    check(d.io == 0 && d.status == 0 && !FT_WTIMEDOUT(d.status) && d.spent < 1000,
+          "deadline: a child done in time reads to EOF and exits 0");
+    check(!FT_WTIMEDOUT(-1), "deadline: FT_WTIMEDOUT(-1) is false");
+
+    deadline_nopidfd();
+}
+
+#define PATH_A "/tmp/ft_pathcache_a"
+#define PATH_B "/tmp/ft_pathcache_b"
+
+static void make_tool(const char *path) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0755);
+
+    if (fd != -1) {
+        if (write(fd, "#!/bin/sh\n", 10) != 10)
+            perror(path);
+        close(fd);
+    }
+}
+
+static int resolves_to(const char *name, const char *want) {
+    char out[256];
+
+    return ft_path_resolve(name, out, sizeof(out)) == 0 && strcmp(out, want) == 0;
+}
+
+// With PATH=a:b and the tool first found in b, adding a/tool only shows
+// up once the cached b/tool entry is dropped: that makes hits visible.
+void test_pathcache() {
+    printf("\n=== Testing ft_path_resolve ===\n");
+
+    char *saved = getenv("PATH") ? strdup(getenv("PATH")) : NULL;
+    struct timespec later[2] = {{0, UTIME_OMIT}, {12345, 0}};
+    char out[256];
+
+    mkdir(PATH_A, 0755);
+    mkdir(PATH_B, 0755);
+    setenv("PATH", PATH_A ":" PATH_B, 1);
+    ft_path_flush();
+    make_tool(PATH_B "/tool");
+    check(resolves_to("tool", PATH_B "/tool"), "pathcache: found on the second PATH entry");
+    make_tool(PATH_A "/tool");
+    check(resolves_to("tool", PATH_B "/tool"), "pathcache: hit returns the cached path");
+    setenv("PATH", PATH_A ":" PATH_B ":/nonexistent", 1);
+    check(resolves_to("tool", PATH_A "/tool"), "pathcache: a new PATH drops the cache");
+
+    setenv("PATH", PATH_A ":" PATH_B, 1);
+    unlink(PATH_A "/tool");
+    check(resolves_to("tool", PATH_B "/tool"), "pathcache: cached binary removed, found again");
+    make_tool(PATH_A "/tool");
+    utimensat(AT_FDCWD, PATH_B "/tool", later, 0);
+    check(resolves_to("tool", PATH_A "/tool"), "pathcache: a new mtime drops the entry");
+
+    unlink(PATH_A "/tool");
+    check(resolves_to("tool", PATH_B "/tool"), "pathcache: cached on b once more");
+    make_tool(PATH_A "/tool");
+    struct stat st;
+    stat(PATH_B "/tool", &st);
+    struct timespec same[2] = {{0, UTIME_OMIT}, st.st_mtim};
+    make_tool(PATH_B "/tool.new");
+    utimensat(AT_FDCWD, PATH_B "/tool.new", same, 0);
+    rename(PATH_B "/tool.new", PATH_B "/tool");
+    check(resolves_to("tool", PATH_A "/tool"), "pathcache: a new inode (same mtime) drops the entry");
+
+    check(ft_path_resolve("ft_pathcache_no_such_tool", out, sizeof(out)) == -1
+          && ft_path_resolve(PATH_A "/tool", out, sizeof(out)) == -1
+          && ft_path_resolve("tool", out, 8) == -1,
+          "pathcache: -1 for a missing name, a name with '/' or a short buffer");
+
+    unlink(PATH_A "/tool");
+    unlink(PATH_B "/tool");
+    rmdir(PATH_A);
+    rmdir(PATH_B);
+    if (saved)
+        setenv("PATH", saved, 1);
+    else
+        unsetenv("PATH");
+    free(saved);
+    ft_path_flush();
+}
+
+int main() {
+    printf("🧪 ft_popen API Testing\n");
+    printf("=======================\n");
+
+    LEAK_TRACK(test_pump);
+    LEAK_TRACK(test_drain);
+    LEAK_TRACK(test_zygote);
+    LEAK_TRACK(test_loop);
+    LEAK_TRACK(test_many);
+    LEAK_TRACK(test_memfd);
+    LEAK_TRACK(test_linereader);
+    LEAK_TRACK(test_capture);
+    LEAK_TRACK(test_cache);
+    LEAK_TRACK(test_pathcache);
+    LEAK_TRACK(test_execerr);
+    LEAK_TRACK(test_deadline);
+
+    if (g_failed || leak_failures()) {
+        printf("\n❌ %d check(s) failed, %d leak(s)\n", g_failed, leak_failures());
+        return 1;
+    }
+    printf("\n🏁 All API checks passed\n");
+    return 0;
+}
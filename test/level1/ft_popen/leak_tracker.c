@@ -0,0 +1,159 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include "leak_tracker.h"
+
+static int g_failures = 0;
+
+static int cmp_int(const void *a, const void *b) {
+    return (*(const int *)a > *(const int *)b) - (*(const int *)a < *(const int *)b);
+}
+
+// every fd in /proc/self/fd except the one readdir itself is using
+static int snapshot_fds(t_leak_snapshot *snap) {
+    DIR *dir = opendir("/proc/self/fd");
+    struct dirent *entry;
+    int cap = 64;
+
+    snap->fds = malloc(cap * sizeof(int));
+    snap->nfds = 0;
+    if (dir == NULL || snap->fds == NULL) {
+        if (dir)
+            closedir(dir);
+        return -1;
+    }
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.' || atoi(entry->d_name) == dirfd(dir))
+            continue;
+        if (snap->nfds == cap) {
+            int *tmp = realloc(snap->fds, (cap *= 2) * sizeof(int));
+            if (tmp == NULL)
+                break;
+            snap->fds = tmp;
+        }
+        snap->fds[snap->nfds++] = atoi(entry->d_name);
+    }
+    closedir(dir);
+    qsort(snap->fds, snap->nfds, sizeof(int), cmp_int);
+    return 0;
+}
+
+// state letter of /proc/<pid>/stat, the comm field may hold spaces or ')'
+static char proc_state(int pid) {
+    char path[64];
+    char buf[512];
+    char *p;
+    FILE *f;
+    size_t n;
+
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+    f = fopen(path, "r");
+    if (f == NULL)
+        return '?';
+    n = fread(buf, 1, sizeof(buf) - 1, f);
+    fclose(f);
+    buf[n] = '\0';
+    p = strrchr(buf, ')');
+    return (p && p[1] == ' ') ? p[2] : '?';
+}
+
+// children of every thread of ours, zombies are the ones nobody waited for
+static int snapshot_children(t_leak_snapshot *snap) {
+    DIR *dir = opendir("/proc/self/task");
+    struct dirent *entry;
+    char path[sizeof(entry->d_name) + 32];
+    FILE *f;
+    int pid;
+
+    snap->children = 0;
+    snap->zombies = 0;
+    if (dir == NULL) {
+        snap->children = -1;
+        return -1;
+    }
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.')
+            continue;
+        snprintf(path, sizeof(path), "/proc/self/task/%s/children", entry->d_name);
+        f = fopen(path, "r");
+        if (f == NULL) {
+            snap->children = -1;
+            break;
+        }
+        while (fscanf(f, "%d", &pid) == 1) {
+            snap->children++;
+            if (proc_state(pid) == 'Z')
+                snap->zombies++;
+        }
+        fclose(f);
+    }
+    closedir(dir);
+    return snap->children == -1 ? -1 : 0;
+}
+
+int leak_snapshot(t_leak_snapshot *snap) {
+    int ret = snapshot_fds(snap);
+
+    if (snapshot_children(snap) == -1)
+        ret = -1;
+    return ret;
+}
+
+void leak_snapshot_free(t_leak_snapshot *snap) {
+    free(snap->fds);
+    snap->fds = NULL;
+    snap->nfds = 0;
+}
+
+static void print_new_fds(const t_leak_snapshot *before, const t_leak_snapshot *after) {
+    char path[64];
+    char target[256];
+    ssize_t n;
+
+    for (int i = 0; i < after->nfds; i++) {
+        if (bsearch(&after->fds[i], before->fds, before->nfds, sizeof(int), cmp_int))
+            continue;
+        snprintf(path, sizeof(path), "/proc/self/fd/%d", after->fds[i]);
+        n = readlink(path, target, sizeof(target) - 1);
+        target[n > 0 ? n : 0] = '\0';
+        printf("   leaked fd %d -> %s\n", after->fds[i], target);
+    }
+}
+
+// Compares against a snapshot taken before the test, returns 0 when the
+// test left nothing behind; otherwise prints what it left and counts it
+int leak_check(const char *test, const t_leak_snapshot *before) {
+    t_leak_snapshot after;
+    int leaks = 0;
+
+    leak_snapshot(&after);
+    if (after.nfds > before->nfds) {
+        printf("❌ Leak Check FAILED (%s): %d fd(s) still open\n", test,
+               after.nfds - before->nfds);
+        print_new_fds(before, &after);
+        leaks++;
+    }
+    if (before->children != -1 && after.zombies > before->zombies) {
+        printf("❌ Leak Check FAILED (%s): %d zombie(s) never waited for\n", test,
+               after.zombies - before->zombies);
+        leaks++;
+    }
+    if (before->children != -1
+        && after.children - after.zombies > before->children - before->zombies) {
+        printf("❌ Leak Check FAILED (%s): %d child(ren) still running\n", test,
+               (after.children - after.zombies) - (before->children - before->zombies));
+        leaks++;
+    }
+    if (leaks == 0)
+        printf("✅ Leak Check PASSED (%s): fds %d, children %d, zombies %d\n", test,
+               after.nfds, after.children, after.zombies);
+    leak_snapshot_free(&after);
+    g_failures += leaks;
+    return leaks;
+}
+
+int leak_failures(void) {
+    return g_failures;
+}
@@ -0,0 +1,34 @@
+#ifndef LEAK_TRACKER_H
+# define LEAK_TRACKER_H
+
+// In-process replacement for the valgrind run: a snapshot of our open fds,
+// live children and zombies (all read from /proc, no syscall wrapping)
+// is taken before a test and compared after it. Anything the test left
+// behind is printed and counted, main() turns the count into its exit
+// status so a leak fails the build instead of waiting for a manual run.
+//
+//     LEAK_TRACK(test_fd_leaks);
+//     ...
+//     return leak_failures() ? 1 : 0;
+
+typedef struct s_leak_snapshot {
+    int *fds;       // sorted fd numbers, malloc'd
+    int nfds;
+    int children;   // -1 when /proc/<tid>/children is not available
+    int zombies;
+} t_leak_snapshot;
+
+int  leak_snapshot(t_leak_snapshot *snap);
+void leak_snapshot_free(t_leak_snapshot *snap);
+int  leak_check(const char *test, const t_leak_snapshot *before);
+int  leak_failures(void);
+
+# define LEAK_TRACK(test) do { \
+        t_leak_snapshot leak_before_; \
+        leak_snapshot(&leak_before_); \
+        test(); \
+        leak_check(#test, &leak_before_); \
+        leak_snapshot_free(&leak_before_); \
+    } while (0)
+
+#endif
@@ -5,8 +5,12 @@
 #include <sys/wait.h>
 #include <fcntl.h>
 #include <dirent.h>
+#include <time.h>
+#include <sys/resource.h>
+#include "leak_tracker.h"
 
 // Include the ft_popen function prototype
+// Build: gcc -o test_comprehensive main.c leak_tracker.c <ft_popen sources>
 int ft_popen(const char *file, char *const argv[], char type);
 
 // Function to count open file descriptors for current process
@@ -74,6 +78,78 @@ void test_fd_leaks() {
     }
 }
 
+void test_spawn_with_many_fds() {
+    printf("\n=== Testing SPAWN WITH MANY OPEN FDS ===\n");
+    
+    const int wanted = 50000;
+    const int spawns = 20;
+    struct rlimit rl;
+    
+    // Raise the soft limit as far as the hard limit allows
+    getrlimit(RLIMIT_NOFILE, &rl);
+    if (rl.rlim_cur < (rlim_t)wanted + 64) {
+        rl.rlim_cur = rl.rlim_max < (rlim_t)wanted + 64 ? rl.rlim_max : (rlim_t)wanted + 64;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+    int target = (int)rl.rlim_cur - 64 < wanted ? (int)rl.rlim_cur - 64 : wanted;
+    int *fds = malloc(sizeof(int) * (target > 0 ? target : 1));
+    int base = open("/dev/null", O_RDONLY);
+    int opened = 0;
+    while (fds && base != -1 && opened < target) {
+        int fd = dup(base);
+        if (fd == -1)
+            break;
+        fds[opened++] = fd;
+    }
+    if (opened < wanted) {
+        printf("⚠️  Only %d extra FDs available (RLIMIT_NOFILE), measuring with those\n", opened);
+    }
+    
+    // Time the spawns and count what the child sees in /proc/self/fd
+    struct timespec t0, t1;
+    int max_child_fds = 0;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (int i = 0; i < spawns; i++) {
+        char *args[] = {"ls", "/proc/self/fd", NULL};
+        int fd = ft_popen("ls", args, 'r');
+        if (fd == -1) {
+            max_child_fds = -1;
+            break;
+        }
+        char buffer[4096];
+        ssize_t bytes;
+        int lines = 0;
+        while ((bytes = read(fd, buffer, sizeof(buffer))) > 0) {
+            for (ssize_t j = 0; j < bytes; j++) {
+                if (buffer[j] == '\n')
+                    lines++;
+            }
+        }
+        close(fd);
+        wait(NULL);
+        if (lines > max_child_fds)
+            max_child_fds = lines;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double avg_ms = ((t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) / 1e6) / spawns;
+    printf("Spawn time with %d open FDs: %.3f ms per ft_popen (avg of %d)\n", opened, avg_ms, spawns);
+    
+    // 0, 1, 2 plus the directory fd ls itself opens
+    if (max_child_fds == -1) {
+        printf("❌ Many FDs Test FAILED: ft_popen returned -1\n");
+    } else if (max_child_fds <= 4) {
+        printf("✅ Many FDs Test PASSED: Child only saw %d FDs\n", max_child_fds);
+    } else {
+        printf("❌ Many FDs Test FAILED: Child inherited %d FDs\n", max_child_fds);
+    }
+    
+    for (int i = 0; i < opened; i++)
+        close(fds[i]);
+    if (base != -1)
+        close(base);
+    free(fds);
+}
+
 void test_child_process_cleanup() {
     printf("\n=== Testing CHILD PROCESS CLEANUP ===\n");
     
@@ -186,85 +262,48 @@ void test_stress_multiple_operations() {
     }
 }
 
-void run_comprehensive_valgrind_test() {
-    printf("\n=== COMPREHENSIVE VALGRIND ANALYSIS ===\n");
-    printf("Running with flags: --leak-check=full --show-leak-kinds=all --track-origins=yes -s --track-fds=yes\n");
+void test_repeated_and_error_paths() {
+    printf("\n=== Testing REPEATED AND ERROR PATHS ===\n");
     
-    // Check if we're already running under valgrind
-    if (getenv("VALGRIND_OPTS") != NULL) {
-        printf("✅ Already running under valgrind - performing comprehensive tests\n");
-        
-        // Perform memory-intensive operations
-        printf("🔍 Testing memory allocation patterns...\n");
-        
-        // Test 1: Multiple allocations and frees (simulating complex operations)
-        for (int i = 0; i < 5; i++) {
-            char *test_buffer = malloc(1024);
-            if (test_buffer) {
-                memset(test_buffer, 'A' + i, 1024);
-                free(test_buffer);
-            }
-        }
-        
-        // Test 2: Multiple ft_popen operations with comprehensive tracking
-        printf("🔍 Testing ft_popen memory patterns...\n");
-        for (int i = 0; i < 3; i++) {
-            char *args[] = {"echo", "valgrind test", NULL};
-            int fd = ft_popen("echo", args, 'r');
-            if (fd != -1) {
-                char buffer[256];
-                ssize_t bytes = read(fd, buffer, sizeof(buffer) - 1);
-                if (bytes > 0) {
-                    buffer[bytes] = '\0';
-                }
-                close(fd);
-                wait(NULL);
+    // Repeated ft_popen / read / close / wait cycles
+    for (int i = 0; i < 3; i++) {
+        char *args[] = {"echo", "leak test", NULL};
+        int fd = ft_popen("echo", args, 'r');
+        if (fd != -1) {
+            char buffer[256];
+            ssize_t bytes = read(fd, buffer, sizeof(buffer) - 1);
+            if (bytes > 0) {
+                buffer[bytes] = '\0';
             }
+            close(fd);
+            wait(NULL);
         }
-        
-        // Test 3: Error condition memory tracking
-        printf("🔍 Testing error condition memory patterns...\n");
-        ft_popen(NULL, NULL, 'r');
-        ft_popen("echo", NULL, 'w');
-        ft_popen(NULL, (char*[]){"test", NULL}, 'x');
-        
-        printf("✅ Comprehensive valgrind test patterns completed\n");
-        printf("📊 Check valgrind output above for detailed memory analysis\n");
-        
-    } else {
-        printf("💡 To run comprehensive valgrind analysis, use:\n");
-        printf("   valgrind --leak-check=full --show-leak-kinds=all --track-origins=yes -s --track-fds=yes ./test_comprehensive\n");
-        printf("\n📋 Valgrind flags explanation:\n");
-        printf("   --leak-check=full      : Check for all types of memory leaks\n");
-        printf("   --show-leak-kinds=all  : Show definite, indirect, possible, and reachable leaks\n");
-        printf("   --track-origins=yes    : Track origins of uninitialized values\n");
-        printf("   -s                     : Show error summary and suppressed errors\n");
-        printf("   --track-fds=yes        : Track file descriptor leaks\n");
-        
-        printf("\n🚀 Executing comprehensive valgrind test now...\n");
-        
-        // Execute valgrind with comprehensive flags
-        char command[512];
-        snprintf(command, sizeof(command), 
-                "valgrind --leak-check=full --show-leak-kinds=all --track-origins=yes -s --track-fds=yes ./test_comprehensive");
-        
-        printf("Executing: %s\n", command);
-        printf("⚠️  Note: This will create a recursive call, so we'll skip auto-execution.\n");
-        printf("🔧 Please run the command above manually for full valgrind analysis.\n");
     }
+    
+    // Invalid arguments must fail without creating a pipe or a child
+    ft_popen(NULL, NULL, 'r');
+    ft_popen("echo", NULL, 'w');
+    ft_popen(NULL, (char*[]){"test", NULL}, 'x');
+    printf("✅ Repeated and error paths completed\n");
 }
 
 int main() {
     printf("🧪 Comprehensive ft_popen Testing (Memory & FD Management)\n");
     printf("=========================================================\n");
     
-    test_fd_leaks();
-    test_child_process_cleanup();
-    test_pipe_closure_on_errors();
-    test_dup2_failure_simulation();
-    test_stress_multiple_operations();
-    run_comprehensive_valgrind_test();
+    // each test runs between two leak snapshots, see leak_tracker.h
+    LEAK_TRACK(test_fd_leaks);
+    LEAK_TRACK(test_spawn_with_many_fds);
+    LEAK_TRACK(test_child_process_cleanup);
+    LEAK_TRACK(test_pipe_closure_on_errors);
+    LEAK_TRACK(test_dup2_failure_simulation);
+    LEAK_TRACK(test_stress_multiple_operations);
+    LEAK_TRACK(test_repeated_and_error_paths);
     
+    if (leak_failures()) {
+        printf("\n❌ %d leak(s) detected\n", leak_failures());
+        return 1;
+    }
     printf("\n🏁 Comprehensive testing completed!\n");
     
     return 0;
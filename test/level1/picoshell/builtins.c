@@ -0,0 +1,203 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include "../../../ran04/level1/picoshell/picoshell.h"
+
+// Every builtin stage (cat, head, wc, grep -F) must be indistinguishable
+// from the command it replaces: each case runs once with the builtins and
+// once with picoshell_set_builtins(0), and stdout, stderr, the return
+// value and every stage's exit code / signal have to match.
+// Build: gcc -pthread -o test_builtins builtins.c
+//        ../../../ran04/level1/picoshell/picoshell.c
+//        ../../../ran04/level1/picoshell/picoshell_builtins.c
+//        ../../../ran04/level1/picoshell/picoshell_parse.c
+//        ../../../ran04/level1/common/ft_pathcache.c
+
+#define SMALL "/tmp/picoshell_builtins_small"
+#define BIG   "/tmp/picoshell_builtins_big"
+#define CTRL  "/tmp/picoshell_builtins_ctrl"
+
+static int g_failed = 0;
+
+typedef struct s_run {
+    char *out;
+    size_t outlen;
+    char *err;
+    size_t errlen;
+    int ret;
+    t_stage_report r[4];
+} t_run;
+
+typedef struct s_case {
+    const char *name;
+    char **cmds[4];
+    const char *in;
+} t_case;
+
+static char *slurp(int fd, size_t *len) {
+    off_t size = lseek(fd, 0, SEEK_END);
+    char *buf = malloc(size + 1);
+
+    *len = pread(fd, buf, size, 0);
+    buf[*len] = '\0';
+    close(fd);
+    return buf;
+}
+
+// stdout and stderr go to memfds for the run, the stages inherit them
+static void run(const t_case *c, int builtins, t_run *res) {
+    t_redirs redir = {c->in, NULL, 0, 0};
+    int out = memfd_create("out", MFD_CLOEXEC);
+    int err = memfd_create("err", MFD_CLOEXEC);
+    int saved_out = dup(STDOUT_FILENO);
+    int saved_err = dup(STDERR_FILENO);
+
+    fflush(stdout);
+    dup2(out, STDOUT_FILENO);
+    dup2(err, STDERR_FILENO);
+    picoshell_set_builtins(builtins);
+    res->ret = picoshell_redir((char ***)c->cmds, &redir, res->r);
+    picoshell_set_builtins(1);
+    dup2(saved_out, STDOUT_FILENO);
+    dup2(saved_err, STDERR_FILENO);
+    close(saved_out);
+    close(saved_err);
+    res->out = slurp(out, &res->outlen);
+    res->err = slurp(err, &res->errlen);
+}
+
+static int nstages(const t_case *c) {
+    int n = 0;
+
+    while (c->cmds[n])
+        n++;
+    return n;
+}
+
+static void compare(const t_case *c) {
+    t_run b;
+    t_run e;
+    int ok;
+    int threads = 0;
+
+    run(c, 1, &b);
+    run(c, 0, &e);
+    ok = b.ret == e.ret && b.outlen == e.outlen && memcmp(b.out, e.out, b.outlen) == 0
+         && b.errlen == e.errlen && memcmp(b.err, e.err, b.errlen) == 0;
+    for (int i = 0; i < nstages(c); i++) {
+        ok = ok && b.r[i].exit_code == e.r[i].exit_code
+             && b.r[i].term_signal == e.r[i].term_signal && e.r[i].pid > 0;
+        threads += b.r[i].pid == 0;
+    }
+    // a case that ran no builtin would compare the real command to itself
+    ok = ok && threads > 0;
+    printf("%s %s\n", ok ? "✅" : "❌", c->name);
+    if (!ok) {
+        g_failed++;
+        printf("   builtin: ret %d, %zu bytes out, stderr \"%.*s\"\n", b.ret, b.outlen,
+               (int)b.errlen, b.err);
+        printf("   command: ret %d, %zu bytes out, stderr \"%.*s\"\n", e.ret, e.outlen,
+               (int)e.errlen, e.err);
+        for (int i = 0; i < nstages(c); i++)
+            printf("   stage %d: builtin pid %d exit %d sig %d / command exit %d sig %d\n", i,
+                   (int)b.r[i].pid, b.r[i].exit_code, b.r[i].term_signal,
+                   e.r[i].exit_code, e.r[i].term_signal);
+    }
+    free(b.out);
+    free(b.err);
+    free(e.out);
+    free(e.err);
+}
+
+static void make_files(void) {
+    FILE *f = fopen(SMALL, "w");
+
+    fputs("foo bar\nbaz\n  two  words \n\nfoofoo\nno newline foo", f);
+    fclose(f);
+    // control bytes and UTF-8: in the C locale only printable bytes
+    // start a word
+    f = fopen(CTRL, "w");
+    fputs("a\x01" "b c\xc3\xa9 \x02\x03 d\n\x7f\n", f);
+    fclose(f);
+    // 8 MiB: far more than any pipe holds, so a writer whose reader is
+    // gone always hits EPIPE
+    f = fopen(BIG, "w");
+    for (int i = 0; i < 1000000; i++)
+        fprintf(f, "line %07d\n", i);
+    fclose(f);
+}
+
+#define CMD(...) ((char *[]){__VA_ARGS__, NULL})
+
+int main(void) {
+    char *seq100[] = {"seq", "1", "100", NULL};
+    char *seq1000[] = {"seq", "1", "1000", NULL};
+    // more than a pipe holds: a reader that stops early always kills it
+    char *seq_big[] = {"seq", "1", "1000000", NULL};
+    char *cat_big[] = {"cat", BIG, NULL};
+    char *cat_small[] = {"cat", SMALL, NULL};
+    char *nothing[] = {"true", NULL};
+    const t_case cases[] = {
+        {"cat file", {cat_small}, NULL},
+        {"cat file - < file", {CMD("cat", SMALL, "-")}, SMALL},
+        {"cat file missing file", {CMD("cat", SMALL, "/nonexistent/x", SMALL)}, NULL},
+        {"cat /tmp (a directory)", {CMD("cat", "/tmp")}, NULL},
+        {"cat < /tmp", {CMD("cat")}, "/tmp"},
+        {"seq | cat", {seq1000, CMD("cat")}, NULL},
+        {"seq | head -n 5", {seq100, CMD("head", "-n", "5")}, NULL},
+        {"seq | head -3", {seq100, CMD("head", "-3")}, NULL},
+        {"seq | head -n7", {seq100, CMD("head", "-n7")}, NULL},
+        {"seq | head", {seq100, CMD("head")}, NULL},
+        {"seq | head -n 0", {seq_big, CMD("head", "-n", "0")}, NULL},
+        {"seq | head -n 500", {seq100, CMD("head", "-n", "500")}, NULL},
+        {"head < /tmp", {CMD("head")}, "/tmp"},
+        {"cat file | wc", {cat_small, CMD("wc")}, NULL},
+        {"seq | wc -l", {seq1000, CMD("wc", "-l")}, NULL},
+        {"wc -w -c < file", {CMD("wc", "-w", "-c")}, SMALL},
+        {"wc -lw < file", {CMD("wc", "-lw")}, SMALL},
+        {"wc < /tmp", {CMD("wc")}, "/tmp"},
+        {"wc -l < /tmp", {CMD("wc", "-l")}, "/tmp"},
+        {"wc -w < control bytes", {CMD("wc", "-w")}, CTRL},
+        {"wc < control bytes", {CMD("wc")}, CTRL},
+        {"grep -F foo < file", {CMD("grep", "-F", "foo")}, SMALL},
+        {"grep -Fv foo < file", {CMD("grep", "-Fv", "foo")}, SMALL},
+        {"grep -F -v foo < file", {CMD("grep", "-F", "-v", "foo")}, SMALL},
+        {"seq | grep -F 7", {seq1000, CMD("grep", "-F", "7")}, NULL},
+        {"grep -F nomatch < file", {CMD("grep", "-F", "nomatch")}, SMALL},
+        {"grep -F foo < /tmp", {CMD("grep", "-F", "foo")}, "/tmp"},
+        // two patterns: grep runs for real behind the cat builtin
+        {"cat file | grep -F 'foo<nl>baz'", {cat_small, CMD("grep", "-F", "foo\nbaz")}, NULL},
+        // the reader is gone: every builtin must die of SIGPIPE like the command
+        {"cat big | head -c 1", {cat_big, CMD("head", "-c", "1")}, NULL},
+        {"cat big | true", {cat_big, nothing}, NULL},
+        {"cat big big | head -c 1", {CMD("cat", BIG, BIG), CMD("head", "-c", "1")}, NULL},
+        {"cat - < big | true", {CMD("cat", "-"), nothing}, BIG},
+        {"cat big | head -n 900000 | true", {cat_big, CMD("head", "-n", "900000"), nothing}, NULL},
+        {"cat big | wc | true", {cat_big, CMD("wc"), nothing}, NULL},
+        {"cat big | grep -F line | true", {cat_big, CMD("grep", "-F", "line"), nothing}, NULL},
+        {"cat big | grep -Fv x | true", {cat_big, CMD("grep", "-Fv", "x"), nothing}, NULL},
+    };
+
+    printf("🧪 picoshell builtins vs. the real commands\n");
+    printf("===========================================\n");
+    // the builtins reproduce the C locale, so the commands must run in it
+    setenv("LC_ALL", "C", 1);
+    make_files();
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        compare(&cases[i]);
+    }
+    unlink(SMALL);
+    unlink(BIG);
+    unlink(CTRL);
+    if (g_failed) {
+        printf("\n❌ %d case(s) differ\n", g_failed);
+        return 1;
+    }
+    printf("\n🏁 Every builtin matches its command\n");
+    return 0;
+}
@@ -0,0 +1,230 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "../../../ran04/level1/picoshell/picoshell.h"
+
+// picoshell_parse(): every line is compiled and its stages printed as
+// "[word][word] | [word]", then compared with what sh would have split.
+// A NULL expectation means a syntax error: NULL with errno EINVAL.
+// Build: gcc -pthread -o test_parse parse.c
+//        ../../../ran04/level1/picoshell/picoshell.c
+//        ../../../ran04/level1/picoshell/picoshell_builtins.c
+//        ../../../ran04/level1/picoshell/picoshell_parse.c
+//        ../../../ran04/level1/common/ft_pathcache.c
+
+#define OUT "/tmp/picoshell_parse_out"
+
+static int g_failed = 0;
+
+typedef struct s_case {
+    const char *line;
+    const char *cmds;
+    const char *in;
+    const char *out;
+    int append;
+} t_case;
+
+static void check(int ok, const char *what) {
+    printf("%s %s\n", ok ? "✅" : "❌", what);
+    if (!ok)
+        g_failed++;
+}
+
+static void dump(t_pipeline *p, char *buf, size_t size) {
+    size_t len = 0;
+
+    buf[0] = '\0';
+    for (int i = 0; p->cmds[i]; i++) {
+        if (i)
+            len += snprintf(buf + len, size - len, " | ");
+        for (int j = 0; p->cmds[i][j]; j++)
+            len += snprintf(buf + len, size - len, "[%s]", p->cmds[i][j]);
+    }
+}
+
+static int same_str(const char *a, const char *b) {
+    return (!a && !b) || (a && b && strcmp(a, b) == 0);
+}
+
+// the line as it would be typed: a newline shows as \n
+static const char *printable(const char *line, char *buf, size_t size) {
+    size_t len = 0;
+
+    for (; *line && len + 3 < size; line++) {
+        if (*line == '\n') {
+            buf[len++] = '\\';
+            buf[len++] = 'n';
+        } else
+            buf[len++] = *line;
+    }
+    buf[len] = '\0';
+    return buf;
+}
+
+static void test_parse(const t_case *c) {
+    char got[512];
+    char shown[512];
+    char what[1200];
+    char line[128];
+    t_pipeline *p;
+    int ok;
+    int n = 0;
+
+    errno = 0;
+    p = picoshell_parse(c->line);
+    printable(c->line, line, sizeof(line));
+    if (!c->cmds) {
+        snprintf(what, sizeof(what), "%-32s -> EINVAL", line);
+        check(!p && errno == EINVAL, what);
+        picoshell_free(p);
+        return;
+    }
+    if (!p) {
+        snprintf(what, sizeof(what), "%-32s -> %s (got %s)", line, c->cmds, strerror(errno));
+        check(0, what);
+        return;
+    }
+    dump(p, got, sizeof(got));
+    ok = strcmp(got, c->cmds) == 0 && same_str(p->redir.in, c->in)
+         && same_str(p->redir.out, c->out) && p->redir.append == c->append;
+    while (p->cmds[n])
+        n++;
+    ok = ok && n == p->ncmds;
+    snprintf(what, sizeof(what), "%-32s -> %s", line, printable(got, shown, sizeof(shown)));
+    check(ok, what);
+    if (!ok)
+        printf("   expected %s, in %s, out %s%s\n", c->cmds, c->in ? c->in : "-",
+               c->out ? c->out : "-", c->append ? " (append)" : "");
+    picoshell_free(p);
+}
+
+static int file_is(const char *path, const char *want) {
+    char buf[256];
+    int fd = open(path, O_RDONLY);
+    ssize_t n;
+
+    if (fd == -1)
+        return 0;
+    n = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (n < 0)
+        return 0;
+    buf[n] = '\0';
+    return strcmp(buf, want) == 0;
+}
+
+// picoshell_run() goes through the parse cache: the second run of a line
+// reuses the first parse and must behave the same
+static void test_run(void) {
+    const char *line = "echo hello world | tr a-z A-Z > " OUT;
+
+    unlink(OUT);
+    check(picoshell_run(line, NULL) == 0 && file_is(OUT, "HELLO WORLD\n"), "run: first parse");
+    unlink(OUT);
+    check(picoshell_run(line, NULL) == 0 && file_is(OUT, "HELLO WORLD\n"), "run: cached parse");
+    check(picoshell_run("echo again >> " OUT, NULL) == 0
+          && file_is(OUT, "HELLO WORLD\nagain\n"), "run: >> appends");
+    check(picoshell_run("tr a-z A-Z < " OUT " | grep -F AGAIN > " OUT ".2", NULL) == 0
+          && file_is(OUT ".2", "AGAIN\n"), "run: < and > together");
+    check(picoshell_run("echo |", NULL) == 1, "run: syntax error returns 1");
+    check(picoshell_run("echo |", NULL) == 1, "run: syntax error, same line again");
+    picoshell_cache_flush();
+    check(picoshell_run(line, NULL) == 0 && file_is(OUT, "HELLO WORLD\n"), "run: after cache flush");
+    unlink(OUT);
+    unlink(OUT ".2");
+    picoshell_cache_flush();
+}
+
+// no stage at all: the redirection files are still opened (sh creates
+// "> file" too), closed again and the result is 0
+static void test_empty(void) {
+    char **none[] = {NULL};
+    t_redirs redir = {"/dev/null", OUT, 0, 0};
+    int before = dup(0);
+    int after;
+
+    close(before);
+    unlink(OUT);
+    check(picoshell_redir(none, &redir, NULL) == 0 && access(OUT, F_OK) == 0,
+          "redir: no stage returns 0");
+    after = dup(0);
+    close(after);
+    check(after == before, "redir: no stage leaves no fd open");
+    unlink(OUT);
+}
+
+int main(void) {
+    const t_case cases[] = {
+        {"ls -l | grep foo | wc -l", "[ls][-l] | [grep][foo] | [wc][-l]", NULL, NULL, 0},
+        {"  a\t b  ", "[a][b]", NULL, NULL, 0},
+        {"a|b", "[a] | [b]", NULL, NULL, 0},
+        // quoting
+        {"echo 'a b' c", "[echo][a b][c]", NULL, NULL, 0},
+        {"echo \"a b\"c", "[echo][a bc]", NULL, NULL, 0},
+        {"echo ''", "[echo][]", NULL, NULL, 0},
+        {"echo \"\" ''\"\"", "[echo][][]", NULL, NULL, 0},
+        {"echo 'x|y' \"<z>\"", "[echo][x|y][<z>]", NULL, NULL, 0},
+        {"echo a\\ b a\\|b", "[echo][a b][a|b]", NULL, NULL, 0},
+        {"echo 'a\\b' \"a\\b\"", "[echo][a\\b][a\\b]", NULL, NULL, 0},
+        {"echo \"\\\" \\\\ \\$ \\`\"", "[echo][\" \\ $ `]", NULL, NULL, 0},
+        {"echo \"it's\" 'say \"hi\"'", "[echo][it's][say \"hi\"]", NULL, NULL, 0},
+        // \<newline> is a line continuation, except inside '...'
+        {"echo a\\\nb", "[echo][ab]", NULL, NULL, 0},
+        {"echo \"a\\\nb\"", "[echo][ab]", NULL, NULL, 0},
+        {"echo 'a\\\nb'", "[echo][a\\\nb]", NULL, NULL, 0},
+        {"echo \\\n b \\\n", "[echo][b]", NULL, NULL, 0},
+        {"echo a \\\n| cat", "[echo][a] | [cat]", NULL, NULL, 0},
+        {"cat \\\n< in | wc >\\\nout", "[cat] | [wc]", "in", "out", 0},
+        // redirections
+        {"cat < in | wc > out", "[cat] | [wc]", "in", "out", 0},
+        {"cat<in>>out", "[cat]", "in", "out", 1},
+        {"< in cat", "[cat]", "in", NULL, 0},
+        {"cat > a > b", "[cat]", NULL, "b", 0},
+        {"cat > 'a b'", "[cat]", NULL, "a b", 0},
+        {"echo '>' \\<", "[echo][>][<]", NULL, NULL, 0},
+        {"echo 2 > x", "[echo][2]", NULL, "x", 0},
+        {"echo a2>x", "[echo][a2]", NULL, "x", 0},
+        {"echo '2'>x", "[echo][2]", NULL, "x", 0},
+        // syntax errors
+        {"", NULL, NULL, NULL, 0},
+        {"   ", NULL, NULL, NULL, 0},
+        {"a || b", NULL, NULL, NULL, 0},
+        {"| a", NULL, NULL, NULL, 0},
+        {"a |", NULL, NULL, NULL, 0},
+        {"a | ", NULL, NULL, NULL, 0},
+        {"a >", NULL, NULL, NULL, 0},
+        {"a <", NULL, NULL, NULL, 0},
+        {"a >> | b", NULL, NULL, NULL, 0},
+        {"a > | b", NULL, NULL, NULL, 0},
+        {"a > b | c", NULL, NULL, NULL, 0},
+        {"a | b < c", NULL, NULL, NULL, 0},
+        {"echo 'open", NULL, NULL, NULL, 0},
+        {"echo \"open", NULL, NULL, NULL, 0},
+        {"> out", NULL, NULL, NULL, 0},
+        // fd-prefixed redirections are not supported
+        {"ls /nonexistent 2>/dev/null", NULL, NULL, NULL, 0},
+        {"cat 0<in", NULL, NULL, NULL, 0},
+        {"cat 1>>out", NULL, NULL, NULL, 0},
+        {"2>err cat", NULL, NULL, NULL, 0},
+        {"ls 2\\\n>/dev/null", NULL, NULL, NULL, 0},
+    };
+
+    printf("🧪 picoshell_parse\n");
+    printf("==================\n");
+    errno = 0;
+    check(picoshell_parse(NULL) == NULL && errno == EINVAL, "NULL line -> EINVAL");
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+        test_parse(&cases[i]);
+    test_run();
+    test_empty();
+    if (g_failed) {
+        printf("\n❌ %d check(s) failed\n", g_failed);
+        return 1;
+    }
+    printf("\n🏁 All parser checks passed\n");
+    return 0;
+}